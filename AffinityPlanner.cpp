@@ -0,0 +1,105 @@
+#include "AffinityPlanner.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace sys {
+
+namespace {
+
+// Topology levels from the outside in. Every id is unique machine wide (x2APIC derived, or a
+// cache index), so a level's id alone names its parent.
+enum Level : std::uint32_t { Chip, Node, Die, L3, Core, Cpu, NumLevels };
+
+struct Slot {
+    const LogicalCore * core;
+    std::uint64_t       ids[NumLevels];
+    std::uint32_t       ranks[NumLevels];   // position among the siblings under the same parent
+};
+
+}
+
+std::vector<CpuSet> planAffinity(const Processor &cpu, std::uint32_t workers, Placement placement, std::uint32_t node) noexcept {
+    std::vector<Slot> slots;
+    for (const LogicalCore &core: cpu.getCores()) {
+        if (node == anyNode || core.node == node) {
+            slots.push_back({ &core, { core.chip, core.node, core.die, core.l3, core.core, core.index }, {} });
+        }
+    }
+
+    std::vector<CpuSet> plan;
+    if (slots.empty() || !workers) {
+        return plan;
+    }
+
+    // Compact order is plain topology order.
+    std::sort(slots.begin(), slots.end(), [](const Slot &a, const Slot &b) {
+        return std::lexicographical_compare(a.ids, a.ids + NumLevels, b.ids, b.ids + NumLevels);
+    });
+
+    for (std::uint32_t level = 0; level < NumLevels; ++level) {
+        std::map<std::uint64_t, std::uint32_t> children;                    // parent -> children seen
+        std::map<std::pair<std::uint64_t, std::uint64_t>, std::uint32_t> ranks; // (parent, id) -> rank
+
+        for (Slot &slot: slots) {
+            const std::uint64_t parent = level ? slot.ids[level - 1] : 0;
+            const auto [it, added] = ranks.try_emplace({ parent, slot.ids[level] }, children[parent]);
+            if (added) {
+                ++children[parent];
+            }
+            slot.ranks[level] = it->second;
+        }
+    }
+
+    switch (placement) {
+    case Placement::Compact:
+        break;
+
+    case Placement::Scatter:
+        // Least significant level first: neighbours in the list differ in package, then node, ...
+        std::stable_sort(slots.begin(), slots.end(), [](const Slot &a, const Slot &b) {
+            for (std::uint32_t level = NumLevels; level-- > 0;) {
+                if (a.ranks[level] != b.ranks[level]) {
+                    return a.ranks[level] < b.ranks[level];
+                }
+            }
+            return false;
+        });
+        break;
+
+    case Placement::OnePerCore:
+        std::stable_sort(slots.begin(), slots.end(), [](const Slot &a, const Slot &b) {
+            return a.ranks[Cpu] < b.ranks[Cpu];
+        });
+        break;
+
+    case Placement::OnePerL3: {
+        // Slots are in topology order, so each L3 domain is one run.
+        std::vector<CpuSet> domains;
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            if (!i || slots[i].ids[Chip] != slots[i - 1].ids[Chip] || slots[i].ids[L3] != slots[i - 1].ids[L3]) {
+                domains.emplace_back();
+            }
+            domains.back().set(slots[i].core->index);
+        }
+
+        for (std::uint32_t i = 0; i < workers; ++i) {
+            plan.push_back(domains[i % domains.size()]);
+        }
+        return plan;
+    }
+    }
+
+    for (std::uint32_t i = 0; i < workers; ++i) {
+        plan.push_back({ slots[i % slots.size()].core->index });
+    }
+    return plan;
+}
+
+const char * getPlacementName(Placement placement) noexcept {
+    static const char *names[] = { "compact", "scatter", "one-per-core", "one-per-l3" };
+    return names[static_cast<std::uint32_t>(placement)];
+}
+
+}
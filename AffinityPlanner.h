@@ -0,0 +1,30 @@
+#pragma once
+#ifndef SYS_AFFINITY_PLANNER_H
+#define SYS_AFFINITY_PLANNER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuSet.h"
+#include "Processor.h"
+
+namespace sys {
+
+enum class Placement : std::uint32_t {
+    Compact,        // fill one core, L3, die and package before the next; SMT siblings together
+    Scatter,        // round robin over packages, then nodes, dies, L3s and cores; SMT siblings last
+    OnePerCore,     // first thread of every physical core, siblings only once every core is taken
+    OnePerL3,       // one worker per L3 instance, free to run on any CPU sharing it
+};
+
+inline constexpr std::uint32_t anyNode = -1U;
+
+// One CpuSet per worker. Single CPUs, except OnePerL3 which hands out whole L3 domains. More
+// workers than slots wrap around and share. Empty when no CPU of the processor is on `node`.
+std::vector<CpuSet> planAffinity(const Processor &cpu, std::uint32_t workers, Placement placement, std::uint32_t node = anyNode) noexcept;
+
+const char *        getPlacementName(Placement placement) noexcept;
+
+}
+
+#endif // SYS_AFFINITY_PLANNER_H
@@ -0,0 +1,207 @@
+// Regression harness for the costs this library adds to startup: Processor construction with
+// each probe backend, a CPUID instruction per leaf (a VM exit under most hypervisors), and
+// Thread start + join with and without affinity. Probe and thread costs are measured at 1, 2, 4,
+// ... CPUs by narrowing the affinity mask.
+//
+// Every measurement is warmed up, timed with the TSC and reported as min, median, p99 and mean
+// in ns, minus the cost of the empty timed region. Output is JSON lines: a header describing the
+// machine, then one object per measurement, so runs of different versions can be diffed.
+//
+// usage: cpuid_bench [reps] [warmup]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <pthread.h>
+#endif
+
+#include "CpuSet.h"
+#include "Processor.h"
+#include "Thread.h"
+#include "TopologyProbe.h"
+#include "TscClock.h"
+
+namespace {
+
+constexpr int formatVersion = 1;
+
+struct Stats {
+    double  min;
+    double  median;
+    double  p99;
+    double  mean;
+};
+
+struct Harness {
+    const sys::TscClock &clock;
+    int                 warmup;
+    int                 reps;
+    double              overhead { 0 };     // ns of an empty timed region
+
+    // Times fn() `reps` times after `warmup` untimed calls.
+    template <class Fn>
+    Stats       measure(Fn &&fn, int repetitions = 0) const noexcept {
+        const int n = repetitions ? repetitions : reps;
+        for (int i = 0; i < warmup; ++i) {
+            fn();
+        }
+
+        std::vector<double> samples(n);
+        for (double &sample: samples) {
+            const std::uint64_t t0 = sys::TscClock::ticks();
+            fn();
+            const std::uint64_t t1 = sys::TscClock::ticksOrdered();
+            sample = std::max(0.0, static_cast<double>(clock.toNanos(t1 - t0)) - overhead);
+        }
+
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (const double sample: samples) {
+            sum += sample;
+        }
+        const auto p99 = static_cast<std::size_t>(std::ceil(0.99 * n)) - 1;
+        return { samples.front(), samples[n / 2], samples[std::min<std::size_t>(p99, n - 1)], sum / n };
+    }
+
+    void        report(const char *name, const char *label, std::uint32_t cpus, const Stats &stats, int repetitions = 0) const noexcept {
+        std::printf("{\"name\":\"%s\",\"case\":\"%s\",\"cpus\":%u,\"reps\":%d,\"min_ns\":%.1f,\"median_ns\":%.1f,\"p99_ns\":%.1f,\"mean_ns\":%.1f}\n",
+            name, label, cpus, repetitions ? repetitions : reps, stats.min, stats.median, stats.p99, stats.mean);
+    }
+};
+
+// Brand strings come padded with leading spaces; quotes and backslashes are escaped.
+void printJsonString(const char *s) noexcept {
+    while (*s == ' ') {
+        ++s;
+    }
+    std::putchar('"');
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            std::putchar('\\');
+        }
+        if (static_cast<unsigned char>(*s) >= 0x20) {
+            std::putchar(*s);
+        }
+    }
+    std::putchar('"');
+}
+
+bool setAffinity(const sys::CpuSet &cpus) noexcept {
+#if defined(_MSC_VER)
+    return SetThreadAffinityMask(GetCurrentThread(), cpus.words()[0]) != 0;
+#else
+    return pthread_setaffinity_np(pthread_self(), cpus.byteSize(), cpus.data()) == 0;
+#endif
+}
+
+void cpuid(std::uint32_t leaf, sys::Regs &regs) noexcept {
+#if defined(_MSC_VER)
+    __cpuidex(reinterpret_cast<int *>(&regs), leaf, 0);
+#else
+    __cpuid_count(leaf, 0, regs.eax, regs.ebx, regs.ecx, regs.edx);
+#endif
+}
+
+}
+
+int main(int argc, char **argv) {
+    const int reps = argc > 1 ? std::max(1, std::atoi(argv[1])) : 101;
+    const int warmup = argc > 2 ? std::max(0, std::atoi(argv[2])) : 10;
+
+    const sys::Processor cpu;
+    const sys::TscClock clock { cpu };
+    // Single instructions get ten times the repetitions of probes and thread batches.
+    Harness harness { clock, warmup, reps * 10 };
+
+    // Empty region first; everything after is reported net of it.
+    harness.overhead = harness.measure([]() noexcept {}).median;
+
+    const sys::CpuSet affinity = sys::CpuSet::fromAffinity();
+    const std::vector<std::uint32_t> all(affinity.begin(), affinity.end());
+
+    std::printf("{\"bench\":\"cpuid_bench\",\"format\":%d,\"vendor\":", formatVersion);
+    printJsonString(cpu.getVendorId());
+    std::printf(",\"brand\":");
+    printJsonString(cpu.getBrandId());
+    std::printf(",\"cpus\":%zu,\"hypervisor\":%s,\"tsc_hz\":%llu,\"tsc_source\":\"%s\",\"timer_overhead_ns\":%.1f}\n",
+        all.size(), cpu.has(sys::Feature::HYPERVISOR) ? "true" : "false", static_cast<unsigned long long>(clock.getFrequency()),
+        clock.getSource() == sys::TscClock::Source::Cpuid ? "cpuid" : "calibrated", harness.overhead);
+
+    // One CPUID per leaf on this CPU. Subleaf 0 only: the exit, not the leaf, is the cost.
+    sys::Regs regs {};
+    std::vector<std::uint32_t> leaves;
+    for (const std::uint32_t base: { 0x00000000U, 0x40000000U, 0x80000000U }) {
+        cpuid(base, regs);
+        if (base == 0x40000000 && !cpu.has(sys::Feature::HYPERVISOR)) {
+            continue;
+        }
+        for (std::uint32_t leaf = base; regs.eax >= base && leaf <= std::min(regs.eax, base + 0xFF); ++leaf) {
+            leaves.push_back(leaf);
+        }
+    }
+
+    char label[32];
+    for (const std::uint32_t leaf: leaves) {
+        const Stats stats = harness.measure([leaf, &regs]() noexcept { cpuid(leaf, regs); });
+        std::snprintf(label, sizeof(label), "0x%08x", leaf);
+        harness.report("cpuid", label, 1, stats);
+    }
+
+    // CPU counts 1, 2, 4, ... and all of them.
+    std::vector<std::uint32_t> counts;
+    for (std::uint32_t n = 1; n < all.size(); n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(static_cast<std::uint32_t>(all.size()));
+
+    const struct {
+        sys::ProbeBackend   backend;
+        const char *        label;
+    } backends[] = {
+        { sys::ProbeBackend::Auto,    "auto" },
+        { sys::ProbeBackend::Threads, "threads" },
+        { sys::ProbeBackend::Migrate, "migrate" },
+        { sys::ProbeBackend::Sysfs,   "sysfs" },
+    };
+
+    for (const std::uint32_t n: counts) {
+        sys::CpuSet cpus;
+        for (std::uint32_t i = 0; i < n; ++i) {
+            cpus.set(all[i]);
+        }
+
+        // Processor construction probes the caller's affinity mask.
+        if (!setAffinity(cpus)) {
+            continue;
+        }
+        for (const auto &[backend, name]: backends) {
+            if (sys::getTopologyProbe(backend)->available()) {
+                harness.report("processor", name, n, harness.measure([backend]() noexcept { const sys::Processor probed { backend }; }, reps), reps);
+            }
+        }
+        setAffinity(affinity);
+
+        // n threads started, then all joined; thread i pinned to the i-th CPU, or left free.
+        for (const bool pinned: { false, true }) {
+            const Stats stats = harness.measure([&]() noexcept {
+                std::vector<sys::Thread> threads(n);
+                for (std::uint32_t i = 0; i < n; ++i) {
+                    threads[i] = { []() { return nullptr; } };
+                    threads[i].start(pinned ? sys::CpuSet { all[i] } : sys::CpuSet {});
+                }
+                for (sys::Thread &thread: threads) {
+                    thread.join();
+                }
+            }, reps);
+            harness.report("thread_start_join", pinned ? "affinity" : "free", n, stats, reps);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Throughput of every dispatched kernel at every ISA level the host supports, against scalar.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Dispatch.h"
+
+template <class Fn>
+static double bestSeconds(int reps, Fn &&fn) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        const auto t0 = std::chrono::steady_clock::now();
+        fn();
+        const auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    const int reps = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+    // The odd size leaves a partial vector for the masked and scalar tails.
+    const std::size_t sizes[] = { (4 << 10) + 37, 256 << 10, 16 << 20 };
+
+    const std::size_t maxSize = sizes[std::size(sizes) - 1];
+    auto src = std::make_unique<unsigned char[]>(maxSize);
+    auto dst = std::make_unique<unsigned char[]>(maxSize);
+
+    std::uint64_t seed = 0x243F6A8885A308D3ULL;
+    for (std::size_t i = 0; i < maxSize; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        src[i] = static_cast<unsigned char>(seed >> 56);
+    }
+
+    const sys::Isa best = sys::resolveKernels();
+    std::printf("host isa: %s\n", sys::getIsaName(best));
+    std::printf("%-10s %-8s %10s %10s %8s %s\n", "kernel", "isa", "size", "GB/s", "speedup", "check");
+
+    for (const std::size_t size: sizes) {
+        // Enough passes to make small sizes measurable.
+        const std::size_t passes = std::max<std::size_t>(1, (64 << 20) / size);
+        double scalar[3] {};
+
+        std::uint32_t crcRef = 0;
+        std::uint64_t bitsRef = 0;
+
+        for (std::uint32_t level = 0; level <= static_cast<std::uint32_t>(best); ++level) {
+            const auto isa = sys::resolveKernels(static_cast<sys::Isa>(level));
+            if (static_cast<std::uint32_t>(isa) != level) {
+                continue;
+            }
+
+            std::uint32_t crc = 0;
+            std::uint64_t bits = 0;
+
+            // Otherwise a level that copies nothing passes on what the previous one left behind.
+            std::memset(dst.get(), 0xA5, maxSize);
+
+            const double t[3] = {
+                bestSeconds(reps, [&] { for (std::size_t p = 0; p < passes; ++p) sys::copyMemory(dst.get(), src.get(), size); }),
+                bestSeconds(reps, [&] { for (std::size_t p = 0; p < passes; ++p) crc = sys::crc32c(0, src.get(), size); }),
+                bestSeconds(reps, [&] { for (std::size_t p = 0; p < passes; ++p) bits = sys::countBits(src.get(), size); }),
+            };
+
+            if (level == 0) {
+                std::copy(t, t + 3, scalar);
+                crcRef = crc;
+                bitsRef = bits;
+            }
+
+            const bool copied = std::memcmp(dst.get(), src.get(), size) == 0 && (size == maxSize || dst[size] == 0xA5);
+            const bool ok[3] = { copied, crc == crcRef, bits == bitsRef };
+            const char *names[3] = { "copyMemory", "crc32c", "countBits" };
+
+            for (int k = 0; k < 3; ++k) {
+                const double gbs = static_cast<double>(size * passes) / t[k] / 1e9;
+                std::printf("%-10s %-8s %10zu %10.2f %7.2fx %s\n", names[k], sys::getIsaName(isa), size, gbs, scalar[k] / t[k], ok[k] ? "ok" : "MISMATCH");
+            }
+        }
+
+        const double libc = bestSeconds(reps, [&] { for (std::size_t p = 0; p < passes; ++p) std::memcpy(dst.get(), src.get(), size); });
+        std::printf("%-10s %-8s %10zu %10.2f %7.2fx\n", "memcpy", "libc", size, static_cast<double>(size * passes) / libc / 1e9, scalar[0] / libc);
+    }
+
+    sys::resolveKernels();
+    return 0;
+}
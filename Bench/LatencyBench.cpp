@@ -0,0 +1,188 @@
+// Core-to-core round-trip latency: two threads pinned to a pair of logical CPUs bounce one cache
+// line back and forth. The matrix shows what the reported topology costs in practice.
+//
+// usage: latency_bench [--json] [round trips per sample]
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Processor.h"
+#include "Thread.h"
+
+static constexpr int samples = 5;
+
+struct alignas(sys::cacheLineAlign) Line {
+    std::atomic<std::uint64_t>  value { 0 };
+};
+
+// Stored instead of a round trip count when the measuring thread does not start.
+static constexpr std::uint64_t cancelled = -1ULL;
+
+// Best of several samples, in nanoseconds per round trip; NaN when either CPU cannot be used.
+static double pingPong(std::uint32_t a, std::uint32_t b, std::uint64_t rounds) noexcept {
+    Line line;
+    std::atomic<bool> ready { false };
+
+    sys::Thread pong {
+        [&]() {
+            ready.store(true, std::memory_order_release);
+            for (std::uint64_t n = 0; n < samples * rounds; ++n) {
+                const std::uint64_t expected = 2 * n + 1;
+                for (std::uint64_t v; (v = line.value.load(std::memory_order_acquire)) != expected; ) {
+                    if (v == cancelled) {
+                        return nullptr;
+                    }
+                    _mm_pause();
+                }
+                line.value.store(expected + 1, std::memory_order_release);
+            }
+            return nullptr;
+        }
+    };
+    if (!pong.start({ b })) {
+        return std::nan("");
+    }
+
+    // The measuring side runs on a pinned thread of its own so the caller's affinity is untouched.
+    double best = 0.0;
+    sys::Thread measure {
+        [&]() {
+            while (!ready.load(std::memory_order_acquire)) {
+                _mm_pause();
+            }
+
+            std::uint64_t n = 0;
+            for (int s = 0; s < samples; ++s) {
+                const auto t0 = std::chrono::steady_clock::now();
+                for (std::uint64_t r = 0; r < rounds; ++r, ++n) {
+                    line.value.store(2 * n + 1, std::memory_order_release);
+                    while (line.value.load(std::memory_order_acquire) != 2 * n + 2) {
+                        _mm_pause();
+                    }
+                }
+                const auto t1 = std::chrono::steady_clock::now();
+
+                const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(rounds);
+                best = s ? std::min(best, ns) : ns;
+            }
+            return nullptr;
+        }
+    };
+    if (!measure.start({ a })) {
+        line.value.store(cancelled, std::memory_order_release);
+        pong.join();
+        return std::nan("");
+    }
+    measure.join();
+    pong.join();
+
+    return best;
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    std::uint64_t rounds = 20000;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--json")) {
+            json = true;
+        } else {
+            rounds = std::max<std::uint64_t>(1, std::strtoull(argv[i], nullptr, 0));
+        }
+    }
+
+    const sys::Processor cpu;
+    const auto cores = cpu.getCores();
+    const std::size_t n = cores.size();
+
+    std::vector<double> matrix(n * n, 0.0);
+    std::vector<double> byLevel[sys::numProximityLevels];
+
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = i + 1; j < n; ++j) {
+            const double ns = pingPong(cores[i].index, cores[j].index, rounds);
+            matrix[i * n + j] = matrix[j * n + i] = ns;
+            if (std::isnan(ns)) {
+                continue;
+            }
+            byLevel[static_cast<std::uint32_t>(sys::getProximity(cores[i], cores[j]))].push_back(ns);
+        }
+    }
+
+    const auto summary = [](std::vector<double> &v, double &min, double &median, double &max) {
+        std::sort(v.begin(), v.end());
+        min = v.front();
+        median = v[v.size() / 2];
+        max = v.back();
+    };
+
+    if (json) {
+        std::printf("{\n  \"unit\": \"ns\",\n  \"cpus\": [");
+        for (std::size_t i = 0; i < n; ++i) {
+            std::printf("%s%u", i ? ", " : "", cores[i].index);
+        }
+        std::printf("],\n  \"matrix\": [\n");
+        for (std::size_t i = 0; i < n; ++i) {
+            std::printf("    [");
+            for (std::size_t j = 0; j < n; ++j) {
+                // JSON has no NaN: a pair that could not be measured is null.
+                if (std::isnan(matrix[i * n + j])) {
+                    std::printf("%snull", j ? ", " : "");
+                } else {
+                    std::printf("%s%.1f", j ? ", " : "", matrix[i * n + j]);
+                }
+            }
+            std::printf("]%s\n", i + 1 < n ? "," : "");
+        }
+        std::printf("  ],\n  \"levels\": {");
+        bool first = true;
+        for (std::uint32_t level = 1; level < sys::numProximityLevels; ++level) {
+            auto &v = byLevel[level];
+            if (v.empty()) {
+                continue;
+            }
+            double min, median, max;
+            summary(v, min, median, max);
+            std::printf("%s\n    \"%s\": { \"pairs\": %zu, \"min\": %.1f, \"median\": %.1f, \"max\": %.1f }",
+                first ? "" : ",", sys::getProximityName(static_cast<sys::Proximity>(level)), v.size(), min, median, max);
+            first = false;
+        }
+        std::printf("\n  }\n}\n");
+        return 0;
+    }
+
+    // CSV: the matrix with a header row and column of cpu numbers, then one row per level.
+    std::printf("cpu");
+    for (std::size_t j = 0; j < n; ++j) {
+        std::printf(",%u", cores[j].index);
+    }
+    std::printf("\n");
+    for (std::size_t i = 0; i < n; ++i) {
+        std::printf("%u", cores[i].index);
+        for (std::size_t j = 0; j < n; ++j) {
+            std::printf(",%.1f", matrix[i * n + j]);
+        }
+        std::printf("\n");
+    }
+
+    std::printf("\nlevel,pairs,min,median,max\n");
+    for (std::uint32_t level = 1; level < sys::numProximityLevels; ++level) {
+        auto &v = byLevel[level];
+        if (v.empty()) {
+            continue;
+        }
+        double min, median, max;
+        summary(v, min, median, max);
+        std::printf("%s,%zu,%.1f,%.1f,%.1f\n", sys::getProximityName(static_cast<sys::Proximity>(level)), v.size(), min, median, max);
+    }
+
+    return 0;
+}
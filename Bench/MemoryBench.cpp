@@ -0,0 +1,335 @@
+// Pointer-chasing latency and streaming read/write bandwidth over working sets from 4 KiB to
+// several times the last level cache, on each selected logical CPU, then read bandwidth from all
+// CPUs of each NUMA node at once. Sweep points bracket every detected cache size, and the knees
+// of the latency curve are reported next to the capacities the library detected.
+//
+// usage: memory_bench [max size in MiB] [cpu...]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "Processor.h"
+#include "Thread.h"
+
+static constexpr std::size_t lineSize = sys::cacheLineAlign;
+static constexpr std::size_t minSize = 4 << 10;
+static constexpr std::uint64_t chaseLoads = 1 << 21;
+static constexpr std::size_t streamBytes = 256 << 20;
+
+// Results are folded in here so the compiler cannot drop the loads.
+static std::atomic<std::uint64_t> sink { 0 };
+
+struct alignas(lineSize) ChaseLine {
+    ChaseLine *     next;
+};
+
+struct Point {
+    std::size_t     size;
+    double          latency;    // ns per dependent load
+    double          read;       // GB/s
+    double          write;      // GB/s
+};
+
+struct Level {
+    const char *    name;
+    std::size_t     size;
+};
+
+static void * allocate(std::size_t size) noexcept {
+    // Page aligned and touched, so the first sweep point does not pay for the page faults.
+    void *p = std::aligned_alloc(4096, (size + 4095) & ~std::size_t { 4095 });
+    if (p) {
+        std::memset(p, 0, size);
+    }
+    return p;
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0) noexcept {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// One random cycle through every line (Sattolo), so the prefetchers cannot follow it.
+static double chase(ChaseLine *lines, std::size_t count, std::uint64_t &seed) noexcept {
+    std::vector<std::uint32_t> order(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<std::uint32_t>(i);
+    }
+    for (std::size_t i = count - 1; i > 0; --i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        std::swap(order[i], order[(seed >> 33) % i]);
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        lines[order[i]].next = &lines[order[(i + 1) % count]];
+    }
+
+    ChaseLine *p = lines;
+    for (std::size_t i = 0; i < count; ++i) {
+        p = p->next;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < chaseLoads; ++i) {
+        p = p->next;
+    }
+    const double s = seconds(t0);
+
+    sink.fetch_add(reinterpret_cast<std::uintptr_t>(p), std::memory_order_relaxed);
+    return s * 1e9 / static_cast<double>(chaseLoads);
+}
+
+static std::uint64_t readPass(const std::uint64_t *data, std::size_t words) noexcept {
+    std::uint64_t a = 0, b = 0, c = 0, d = 0;
+    for (std::size_t i = 0; i < words; i += 4) {
+        a += data[i];
+        b += data[i + 1];
+        c += data[i + 2];
+        d += data[i + 3];
+    }
+    return a + b + c + d;
+}
+
+static double readBandwidth(const std::uint64_t *data, std::size_t size) noexcept {
+    const std::size_t passes = std::max<std::size_t>(1, streamBytes / size);
+    std::uint64_t sum = readPass(data, size / 8);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t p = 0; p < passes; ++p) {
+        sum += readPass(data, size / 8);
+    }
+    const double s = seconds(t0);
+
+    sink.fetch_add(sum, std::memory_order_relaxed);
+    return static_cast<double>(passes * size) / s / 1e9;
+}
+
+static double writeBandwidth(std::uint64_t *data, std::size_t size) noexcept {
+    const std::size_t passes = std::max<std::size_t>(1, streamBytes / size);
+    std::memset(data, 1, size);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t p = 0; p < passes; ++p) {
+        std::memset(data, static_cast<int>(p), size);
+    }
+    const double s = seconds(t0);
+
+    return static_cast<double>(passes * size) / s / 1e9;
+}
+
+static std::vector<Level> getLevels(const sys::Processor &cpu, const sys::LogicalCore &core) noexcept {
+    static const char *names[] = { "L1d", "L2", "L3" };
+    const std::uint32_t ids[] = { core.l1d, core.l2, core.l3 };
+
+    std::vector<Level> levels;
+    const auto caches = cpu.getCaches();
+    for (std::size_t i = 0; i < std::size(ids); ++i) {
+        if (ids[i] < caches.size()) {
+            levels.push_back({ names[i], caches[ids[i]].size });
+        }
+    }
+    return levels;
+}
+
+// Powers of two, plus points at 3/4, 5/4 and 3/2 of every detected cache size.
+static std::vector<std::size_t> getSizes(std::span<const Level> levels, std::size_t maxSize) noexcept {
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = minSize; size <= maxSize; size *= 2) {
+        sizes.push_back(size);
+    }
+    for (const Level &level: levels) {
+        for (const std::size_t size: { level.size * 3 / 4, level.size * 5 / 4, level.size * 3 / 2 }) {
+            if (size >= minSize && size <= maxSize) {
+                sizes.push_back(size / lineSize * lineSize);
+            }
+        }
+    }
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    return sizes;
+}
+
+static void printSize(std::size_t size) noexcept {
+    if (size >= (1 << 20)) {
+        std::printf("%8.1f MiB", static_cast<double>(size) / (1 << 20));
+    } else {
+        std::printf("%8.1f KiB", static_cast<double>(size) / (1 << 10));
+    }
+}
+
+static void sweep(const sys::Processor &cpu, const sys::LogicalCore &core, std::size_t maxSize) noexcept {
+    const auto levels = getLevels(cpu, core);
+    const auto sizes = getSizes(levels, maxSize);
+
+    std::vector<Point> points;
+    bool allocated = false;
+    sys::Thread worker {
+        [&]() {
+            // Allocated on the pinned thread, so first touch places it on this CPU's node.
+            void *buffer = allocate(maxSize);
+            allocated = buffer != nullptr;
+            if (!buffer) {
+                return nullptr;
+            }
+
+            std::uint64_t seed = 0x243F6A8885A308D3ULL ^ core.index;
+            for (const std::size_t size: sizes) {
+                Point &point = points.emplace_back();
+                point.size = size;
+                point.latency = chase(static_cast<ChaseLine *>(buffer), size / lineSize, seed);
+                point.read = readBandwidth(static_cast<const std::uint64_t *>(buffer), size);
+                point.write = writeBandwidth(static_cast<std::uint64_t *>(buffer), size);
+            }
+            std::free(buffer);
+            return nullptr;
+        }
+    };
+    worker.start({ core.index });
+    worker.join();
+
+    if (!allocated) {
+        std::printf("\ncpu %u: cannot allocate %zu bytes\n", core.index, maxSize);
+        return;
+    }
+
+    std::printf("\ncpu %u\n%12s %10s %10s %10s  %s\n", core.index, "size", "ns/load", "read GB/s", "write GB/s", "fits");
+    for (const Point &point: points) {
+        const char *fits = "memory";
+        for (const Level &level: levels) {
+            if (point.size <= level.size) {
+                fits = level.name;
+                break;
+            }
+        }
+        printSize(point.size);
+        std::printf(" %10.2f %10.2f %10.2f  %s\n", point.latency, point.read, point.write, fits);
+    }
+
+    // A knee is a step of more than 25% in latency; the nearest detected capacity should sit
+    // between the two points.
+    for (std::size_t i = 1; i < points.size(); ++i) {
+        if (points[i].latency < points[i - 1].latency * 1.25) {
+            continue;
+        }
+
+        const Level *nearest = nullptr;
+        double distance = 0.0;
+        for (const Level &level: levels) {
+            const double d = std::fabs(std::log2(static_cast<double>(level.size) / static_cast<double>(points[i - 1].size)));
+            if (!nearest || d < distance) {
+                nearest = &level;
+                distance = d;
+            }
+        }
+
+        std::printf("knee between");
+        printSize(points[i - 1].size);
+        std::printf(" and");
+        printSize(points[i].size);
+        std::printf(" (%.2f -> %.2f ns)", points[i - 1].latency, points[i].latency);
+        if (nearest) {
+            const bool inside = nearest->size >= points[i - 1].size && nearest->size < points[i].size;
+            std::printf(", detected %s", nearest->name);
+            printSize(nearest->size);
+            std::printf(" %s", inside ? "matches" : "does not match");
+        }
+        std::printf("\n");
+    }
+}
+
+// Every CPU of the node we may run on streams its own buffer at the same time; the result is the
+// total bytes over the slowest thread's time.
+static void nodeBandwidth(const sys::NumaNode &node, std::size_t bytes) noexcept {
+    const sys::CpuSet cpus = node.cpus & sys::CpuSet::fromAffinity();
+    const std::uint32_t n = cpus.count();
+    if (!n) {
+        return;
+    }
+
+    const std::size_t perThread = std::max<std::size_t>(4 << 20, bytes / n) / lineSize * lineSize;
+    std::atomic<std::uint32_t> arrived { 0 };
+    std::atomic<std::uint32_t> started { n };   // lowered for every thread that fails to start
+    std::vector<double> elapsed(n);
+    std::vector<sys::Thread> threads(n);
+
+    std::uint32_t i = 0;
+    for (const std::uint32_t cpu: cpus) {
+        threads[i] = { [&, i]() {
+            // Allocated on the pinned thread, so first touch places it on this node.
+            auto *data = static_cast<std::uint64_t *>(allocate(perThread));
+
+            arrived.fetch_add(1, std::memory_order_acq_rel);
+            while (data && arrived.load(std::memory_order_acquire) < started.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            elapsed[i] = 0.0;
+            if (data) {
+                std::uint64_t sum = 0;
+                const auto t0 = std::chrono::steady_clock::now();
+                for (int pass = 0; pass < 4; ++pass) {
+                    sum += readPass(data, perThread / 8);
+                }
+                elapsed[i] = seconds(t0);
+                sink.fetch_add(sum, std::memory_order_relaxed);
+                std::free(data);
+            }
+            return nullptr;
+        } };
+        if (!threads[i].start({ cpu })) {
+            started.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        ++i;
+    }
+
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    const auto streamed = static_cast<std::uint32_t>(std::count_if(elapsed.begin(), elapsed.end(), [](double s) { return s > 0.0; }));
+    const double slowest = *std::max_element(elapsed.begin(), elapsed.end());
+    std::printf("node %u: %u of %u cpus,", node.id, streamed, node.cpus.count());
+    printSize(perThread);
+    std::printf(" each, %.2f GB/s read\n", slowest > 0.0 ? static_cast<double>(4 * perThread * streamed) / slowest / 1e9 : 0.0);
+}
+
+int main(int argc, char **argv) {
+    const sys::Processor cpu;
+    const auto cores = cpu.getCores();
+    if (cores.empty()) {
+        std::printf("no cores detected\n");
+        return 1;
+    }
+
+    std::size_t llc = 0;
+    for (const sys::Cache &cache: cpu.getCaches()) {
+        llc = std::max<std::size_t>(llc, cache.size);
+    }
+
+    const std::size_t maxSize = argc > 1 ? std::strtoull(argv[1], nullptr, 0) << 20 : std::max<std::size_t>(4 * llc, 64 << 20);
+
+    std::vector<std::uint32_t> selected;
+    for (int i = 2; i < argc; ++i) {
+        selected.push_back(static_cast<std::uint32_t>(std::strtoul(argv[i], nullptr, 0)));
+    }
+
+    for (const sys::LogicalCore &core: cores) {
+        if (selected.empty() || std::find(selected.begin(), selected.end(), core.index) != selected.end()) {
+            sweep(cpu, core, maxSize);
+        }
+    }
+
+    std::printf("\n");
+    for (const sys::NumaNode &node: cpu.getNumaNodes()) {
+        nodeBandwidth(node, maxSize);
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Per-node arenas: where blocks land when allocated from threads pinned to each node, and the
+// cost of an allocate/deallocate pair against malloc/free.
+//
+// usage: numa_bench [none|thp|explicit]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "NumaAllocator.h"
+#include "Thread.h"
+
+template <class Fn>
+static void runOn(const sys::CpuSet &cpus, Fn &&fn) noexcept {
+    sys::Thread thread { [&]() { fn(); return nullptr; } };
+    thread.start(cpus);
+    thread.join();
+}
+
+int main(int argc, char **argv) {
+    const sys::Processor cpu;
+
+    sys::HugePages hugePages = sys::HugePages::None;
+    if (argc > 1 && !std::strcmp(argv[1], "thp")) {
+        hugePages = sys::HugePages::Transparent;
+    } else if (argc > 1 && !std::strcmp(argv[1], "explicit")) {
+        hugePages = sys::HugePages::Explicit;
+    }
+
+    sys::NumaAllocator allocator { cpu, hugePages };
+    static const char *placements[] = { "local", "mbind", "first touch" };
+    std::printf("placement: %s, line %zu, page %zu, huge page %zu, largest class %zu\n\n", placements[static_cast<std::uint32_t>(allocator.getPlacement())],
+        static_cast<std::size_t>(cpu.getCacheLineSize()), allocator.getPageSize(), allocator.getHugePageSize(), allocator.getMaxSmallSize());
+
+    constexpr std::size_t blocks = 100000;
+    constexpr std::size_t small = 200;
+    constexpr std::size_t large = 3 << 20;
+
+    std::printf("%-6s %16s %16s %14s %14s\n", "node", "small on node", "large on node", "arena ns/pair", "malloc ns/pair");
+    for (const sys::NumaNode &node: cpu.getNumaNodes()) {
+        if (node.cpus.empty()) {
+            continue;
+        }
+
+        std::size_t smallLocal = 0, largeLocal = 0;
+        double arenaNs = 0, mallocNs = 0;
+
+        runOn(node.cpus, [&]() {
+            std::vector<void *> ptrs(blocks);
+            for (auto &p: ptrs) {
+                p = allocator.allocate(small);
+                std::memset(p, 1, small);
+            }
+            for (const void *p: ptrs) {
+                smallLocal += sys::getPageNode(p) == node.id;
+            }
+
+            void *big = allocator.allocate(large);
+            std::memset(big, 1, large);
+            for (std::size_t offset = 0; offset < large; offset += allocator.getPageSize()) {
+                largeLocal += sys::getPageNode(static_cast<char *>(big) + offset) == node.id;
+            }
+            allocator.deallocate(big, large);
+
+            // Steady state: everything below comes off the free lists.
+            auto t0 = std::chrono::steady_clock::now();
+            for (int round = 0; round < 10; ++round) {
+                for (auto &p: ptrs) {
+                    allocator.deallocate(p, small);
+                }
+                for (auto &p: ptrs) {
+                    p = allocator.allocate(small);
+                }
+            }
+            arenaNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (10.0 * blocks);
+            for (auto &p: ptrs) {
+                allocator.deallocate(p, small);
+            }
+
+            t0 = std::chrono::steady_clock::now();
+            for (auto &p: ptrs) {
+                p = std::malloc(small);
+            }
+            for (int round = 0; round < 10; ++round) {
+                for (auto &p: ptrs) {
+                    std::free(p);
+                }
+                for (auto &p: ptrs) {
+                    p = std::malloc(small);
+                }
+            }
+            mallocNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (10.0 * blocks);
+            for (auto &p: ptrs) {
+                std::free(p);
+            }
+        });
+
+        std::printf("%-6u %15.1f%% %15.1f%% %14.1f %14.1f\n", node.id, 100.0 * static_cast<double>(smallLocal) / blocks,
+            100.0 * static_cast<double>(largeLocal) / static_cast<double>(large / allocator.getPageSize()), arenaNs, mallocNs);
+    }
+
+    std::printf("\n");
+    for (const sys::NumaNode &node: cpu.getNumaNodes()) {
+        std::printf("node %u: %zu KiB mapped\n", node.id, allocator.getMappedBytes(node.id) >> 10);
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Sharded per-CPU structures against their single shared counterpart, one pinned thread per CPU
+// all hammering at once.
+//
+// usage: percpu_bench [operations per thread, millions]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include "PerCpu.h"
+#include "ReleaseBarrier.h"
+#include "Thread.h"
+
+// Runs body(thread) on a thread pinned to each CPU, released together; returns ns per operation,
+// NaN if no thread could be started.
+template <class Fn>
+static double contend(const sys::Processor &cpu, std::uint64_t operations, Fn &&body) noexcept {
+    const auto cores = cpu.getCores();
+    const auto n = static_cast<std::uint32_t>(cores.size());
+    ReleaseBarrier barrier;
+    std::vector<sys::Thread> threads(n);
+
+    for (std::uint32_t i = 0; i < n; ++i) {
+        threads[i] = {
+            [&, i]() {
+                barrier.arrive();
+                body(i);
+                return nullptr;
+            }
+        };
+        barrier.start(threads[i], sys::CpuSet { cores[i].index });
+    }
+
+    const std::uint32_t started = barrier.release();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    return started ? ns / static_cast<double>(operations * started) : std::nan("");
+}
+
+int main(int argc, char **argv) {
+    const sys::Processor cpu;
+    const std::uint64_t operations = (argc > 1 ? std::max(1, std::atoi(argv[1])) : 10) * 1'000'000ULL;
+
+    std::printf("%zu threads, %llu operations each, current cpu via %s, slots node local: %s\n\n", cpu.getCores().size(),
+        static_cast<unsigned long long>(operations),
+        cpu.getCpuIdSource() == sys::CpuIdSource::Rdpid ? "rdpid" : cpu.getCpuIdSource() == sys::CpuIdSource::Rdtscp ? "rdtscp" : "getcpu",
+        sys::PerCpu<int> { cpu }.isNodeLocal() ? "yes" : "no");
+
+    alignas(sys::cacheLineAlign) std::atomic<std::int64_t> single { 0 };
+    const double atomicNs = contend(cpu, operations, [&](std::uint32_t) {
+        for (std::uint64_t i = 0; i < operations; ++i) {
+            single.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    sys::ShardedCounter sharded { cpu };
+    const double shardedNs = contend(cpu, operations, [&](std::uint32_t) {
+        for (std::uint64_t i = 0; i < operations; ++i) {
+            sharded.add();
+        }
+    });
+
+    std::printf("%-24s %10s\n", "counter", "ns/op");
+    std::printf("%-24s %10.2f\n", "single atomic", atomicNs);
+    std::printf("%-24s %10.2f  (%.1fx)\n", "sharded", shardedNs, atomicNs / shardedNs);
+
+    const auto rollup = sharded.rollup();
+    std::printf("\nsharded total %lld (expected %llu)\n", static_cast<long long>(rollup.total),
+        static_cast<unsigned long long>(operations * cpu.getCores().size()));
+    for (const auto &node: rollup.nodes) {
+        std::printf("  node %u: %lld\n", node.id, static_cast<long long>(node.value));
+        for (const auto &l3: rollup.l3) {
+            if (l3.node == node.id) {
+                std::printf("    l3 %d: %lld\n", static_cast<int>(l3.id), static_cast<long long>(l3.value));
+            }
+        }
+    }
+
+    // Free lists: each thread pops a block and pushes it back.
+    constexpr std::uint32_t blocksPerThread = 256;
+    const std::uint64_t pairs = operations / 4;
+    std::vector<std::uint64_t> blocks(blocksPerThread * cpu.getCores().size());
+
+    std::mutex mutex;
+    std::vector<void *> global;
+    for (auto &block: blocks) {
+        global.push_back(&block);
+    }
+    const double globalNs = contend(cpu, pairs, [&](std::uint32_t) {
+        for (std::uint64_t i = 0; i < pairs; ++i) {
+            void *block;
+            {
+                std::lock_guard lock { mutex };
+                block = global.back();
+                global.pop_back();
+            }
+            std::lock_guard lock { mutex };
+            global.push_back(block);
+        }
+    });
+
+    sys::ShardedFreeList freeList { cpu };
+    for (auto &block: blocks) {
+        freeList.push(&block);
+    }
+    const double freeListNs = contend(cpu, pairs, [&](std::uint32_t) {
+        for (std::uint64_t i = 0; i < pairs; ++i) {
+            void *block = freeList.pop();
+            if (block) {
+                freeList.push(block);
+            }
+        }
+    });
+
+    std::printf("\n%-24s %10s\n", "free list pop+push", "ns/op");
+    std::printf("%-24s %10.2f\n", "mutex + vector", globalNs);
+    std::printf("%-24s %10.2f  (%.1fx)\n", "sharded", freeListNs, globalNs / freeListNs);
+    std::printf("blocks held after: %zu of %zu\n", freeList.size(), blocks.size());
+
+    return 0;
+}
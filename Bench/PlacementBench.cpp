@@ -0,0 +1,136 @@
+// Throughput of the same worker count under each placement policy, on a memory-bound streaming
+// kernel and a compute-bound dependent-multiply kernel.
+//
+// usage: placement_bench [workers] [node]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "AffinityPlanner.h"
+#include "ReleaseBarrier.h"
+#include "Thread.h"
+
+static std::atomic<std::uint64_t> sink { 0 };
+
+// Allocated and touched by the thread that streams it, so first touch places it on that thread's node.
+static std::unique_ptr<std::uint64_t, decltype(&std::free)> allocateStream(std::size_t bytes) noexcept {
+    auto *data = static_cast<std::uint64_t *>(std::malloc(bytes));
+    if (data) {
+        std::memset(data, 1, bytes);
+    }
+    return { data, &std::free };
+}
+
+static std::uint64_t streamKernel(const std::uint64_t *data, std::size_t bytes) noexcept {
+    if (!data) {
+        return 0;
+    }
+
+    const std::size_t words = bytes / sizeof(std::uint64_t);
+    std::uint64_t sum = 0;
+    for (int pass = 0; pass < 8; ++pass) {
+        for (std::size_t i = 0; i < words; i += 4) {
+            sum += data[i] + data[i + 1] + data[i + 2] + data[i + 3];
+        }
+    }
+
+    sink.fetch_add(sum, std::memory_order_relaxed);
+    return 8 * bytes;
+}
+
+static std::uint64_t computeKernel(std::uint64_t iterations) noexcept {
+    std::uint64_t x = 0x9E3779B97F4A7C15ULL, y = 1;
+    for (std::uint64_t i = 0; i < iterations; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        y = y * x + i;
+    }
+    sink.fetch_add(y, std::memory_order_relaxed);
+    return iterations;
+}
+
+// Calls prepare() on one thread per plan entry that starts, then releases them together to run
+// the work() it returned. Only work() is timed; returns units per second over the slowest thread's
+// time.
+template <class Prepare>
+static double runPlan(const std::vector<sys::CpuSet> &plan, Prepare &&prepare) noexcept {
+    const auto n = static_cast<std::uint32_t>(plan.size());
+    ReleaseBarrier barrier;
+    std::atomic<std::uint64_t> units { 0 };
+    std::vector<double> elapsed(n);
+    std::vector<sys::Thread> threads(n);
+
+    for (std::uint32_t i = 0; i < n; ++i) {
+        threads[i] = {
+            [&, i]() {
+                auto work = prepare();
+                barrier.arrive();
+
+                const auto t0 = std::chrono::steady_clock::now();
+                units.fetch_add(work(), std::memory_order_relaxed);
+                elapsed[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                return nullptr;
+            }
+        };
+        barrier.start(threads[i], plan[i]);
+    }
+
+    barrier.release();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    const double s = *std::max_element(elapsed.begin(), elapsed.end());
+
+    return s > 0.0 ? static_cast<double>(units.load()) / s : 0.0;
+}
+
+int main(int argc, char **argv) {
+    const sys::Processor cpu;
+
+    std::set<std::pair<std::uint32_t, std::uint32_t>> physical;
+    for (const sys::LogicalCore &core: cpu.getCores()) {
+        physical.emplace(core.chip, core.core);
+    }
+
+    const std::uint32_t workers = argc > 1 ? std::max(1, std::atoi(argv[1])) : std::max<std::uint32_t>(1, static_cast<std::uint32_t>(physical.size()));
+    const std::uint32_t node = argc > 2 ? static_cast<std::uint32_t>(std::atoi(argv[2])) : sys::anyNode;
+
+    std::size_t llc = 0;
+    for (const sys::Cache &cache: cpu.getCaches()) {
+        llc = std::max<std::size_t>(llc, cache.size);
+    }
+    // Together the buffers are twice the LLC, so the stream kernel is memory bound.
+    const std::size_t bytes = std::max<std::size_t>(8 << 20, 2 * llc / workers) & ~std::size_t { 31 };
+
+    std::printf("%u workers, %zu KiB per stream buffer\n", workers, bytes >> 10);
+    std::printf("%-13s %12s %14s  %s\n", "placement", "stream GB/s", "compute Gop/s", "cpus");
+
+    for (const sys::Placement placement: { sys::Placement::Compact, sys::Placement::Scatter, sys::Placement::OnePerCore, sys::Placement::OnePerL3 }) {
+        const auto plan = sys::planAffinity(cpu, workers, placement, node);
+        if (plan.empty()) {
+            std::printf("%-13s no cpus\n", sys::getPlacementName(placement));
+            continue;
+        }
+
+        const double stream = runPlan(plan, [bytes]() {
+            return [data = allocateStream(bytes), bytes]() { return streamKernel(data.get(), bytes); };
+        });
+        const double compute = runPlan(plan, []() { return []() { return computeKernel(100'000'000); }; });
+
+        std::printf("%-13s %12.2f %14.2f ", sys::getPlacementName(placement), stream / 1e9, compute / 1e9);
+        for (const auto &set: plan) {
+            std::printf(" %u%s", set.first(), set.count() > 1 ? "+" : "");
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
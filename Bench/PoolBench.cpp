@@ -0,0 +1,82 @@
+// Fork-join throughput and steal locality of the work-stealing pool, proximity vs random victims.
+//
+// Every internal task rewrites its range before splitting it, so a child that is stolen by a
+// nearby worker finds its data in a shared cache while a distant thief has to pull it across.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "ThreadPool.h"
+
+static constexpr std::size_t leafWords = 4096; // 32 KiB
+
+static void process(sys::ThreadPool &pool, std::uint64_t *data, std::size_t n, std::atomic<std::uint64_t> &sink) {
+    if (n <= leafWords) {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += data[i];
+        }
+        sink.fetch_add(sum, std::memory_order_relaxed);
+        return;
+    }
+
+    for (std::size_t i = 0; i < n; i += 8) {
+        data[i] += 1;
+    }
+
+    const std::size_t half = n / 2;
+    pool.submit([&pool, data, half, &sink]() { process(pool, data, half, sink); });
+    pool.submit([&pool, data, half, n, &sink]() { process(pool, data + half, n - half, sink); });
+}
+
+int main(int argc, char **argv) {
+    const int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+    const std::size_t words = argc > 2 ? std::strtoull(argv[2], nullptr, 0) : (std::size_t { 32 } << 20) / sizeof(std::uint64_t);
+
+    const sys::Processor cpu;
+    auto data = std::make_unique<std::uint64_t[]>(words);
+
+    std::printf("%-9s %8s %10s %12s", "order", "workers", "time(ms)", "tasks/s");
+    for (std::uint32_t level = 1; level < sys::numProximityLevels; ++level) {
+        std::printf(" %8s", sys::getProximityName(static_cast<sys::Proximity>(level)));
+    }
+    std::printf(" %8s\n", "failed");
+
+    for (const sys::StealOrder order: { sys::StealOrder::Proximity, sys::StealOrder::Random }) {
+        sys::ThreadPool pool { cpu, order };
+        std::atomic<std::uint64_t> sink { 0 };
+
+        // Warm up page tables and worker threads.
+        pool.submit([&]() { process(pool, data.get(), words, sink); });
+        pool.wait();
+        pool.resetStats();
+
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            pool.submit([&]() { process(pool, data.get(), words, sink); });
+            pool.wait();
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        const auto stats = pool.getStats();
+
+        std::uint64_t steals = 0;
+        for (const auto s: stats.steals) {
+            steals += s;
+        }
+
+        std::printf("%-9s %8u %10.1f %12.0f", order == sys::StealOrder::Proximity ? "proximity" : "random",
+            pool.size(), ms, static_cast<double>(stats.executed) / (ms / 1000.0));
+        for (std::uint32_t level = 1; level < sys::numProximityLevels; ++level) {
+            std::printf(" %7.1f%%", steals ? 100.0 * static_cast<double>(stats.steals[level]) / static_cast<double>(steals) : 0.0);
+        }
+        std::printf(" %8llu\n", static_cast<unsigned long long>(stats.failedSteals));
+    }
+
+    return 0;
+}
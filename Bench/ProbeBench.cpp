@@ -0,0 +1,156 @@
+// Startup cost of each topology probe backend, of probing through long-lived per-CPU executors,
+// and of mapping a topology cache written by an earlier run, compared against the per-thread probe.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if !defined(_MSC_VER)
+#include <unistd.h>
+#endif
+
+#include "CpuExecutors.h"
+#include "Processor.h"
+#include "TopologyProbe.h"
+
+static bool sameTopology(const sys::Processor &a, const sys::Processor &b) noexcept {
+    const auto x = a.getCores();
+    const auto y = b.getCores();
+
+    return std::equal(x.begin(), x.end(), y.begin(), y.end(), [](const sys::LogicalCore &l, const sys::LogicalCore &r) {
+        return l.index == r.index && l.x2apic == r.x2apic && l.core == r.core && l.coreType == r.coreType;
+    });
+}
+
+int main(int argc, char **argv) {
+    const int reps = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+    const struct {
+        sys::ProbeBackend backend;
+        const char *      label;
+    } backends[] = {
+        { sys::ProbeBackend::Threads, "threads" },
+        { sys::ProbeBackend::Migrate, "migrate" },
+        { sys::ProbeBackend::Sysfs,   "sysfs" },
+        { sys::ProbeBackend::Auto,    "auto" },
+    };
+
+    const sys::Processor reference { sys::ProbeBackend::Threads };
+    double baseline = 0.0;
+
+    const auto report = [&](const char *label, std::vector<double> &samples, bool match) {
+        std::sort(samples.begin(), samples.end());
+        const double median = samples[samples.size() / 2];
+
+        std::printf("%-8s %6zu %12.1f %12.1f %12.1f %7.2fx %s\n",
+            label, reference.getCores().size(), samples.front(), median, samples.back(),
+            baseline / median, match ? "yes" : "NO");
+        return median;
+    };
+
+    std::printf("%-8s %6s %12s %12s %12s %8s %s\n", "backend", "cpus", "min(us)", "median(us)", "max(us)", "speedup", "match");
+
+    for (const auto &[backend, label]: backends) {
+        if (!sys::getTopologyProbe(backend)->available()) {
+            std::printf("%-8s unavailable\n", label);
+            continue;
+        }
+
+        std::vector<double> samples;
+        samples.reserve(reps);
+
+        bool match = true;
+
+        { const sys::Processor warmup { backend }; }
+
+        for (int i = 0; i < reps; ++i) {
+            const auto t0 = std::chrono::steady_clock::now();
+            const sys::Processor cpu { backend };
+            const auto t1 = std::chrono::steady_clock::now();
+
+            samples.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            match &= sameTopology(cpu, reference);
+        }
+
+        if (backend == sys::ProbeBackend::Threads) {
+            std::sort(samples.begin(), samples.end());
+            baseline = samples[samples.size() / 2];
+        }
+
+        report(label, samples, match);
+    }
+
+    {
+        sys::CpuExecutors executors;
+        const sys::ExecutorProbe probe { executors };
+
+        { const sys::Processor warmup { probe }; }
+
+        std::vector<double> samples;
+        bool match = true;
+
+        for (int i = 0; i < reps; ++i) {
+            const auto t0 = std::chrono::steady_clock::now();
+            const sys::Processor cpu { probe };
+            const auto t1 = std::chrono::steady_clock::now();
+
+            samples.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            match &= sameTopology(cpu, reference);
+        }
+
+        report("executor", samples, match);
+
+        // The per-CPU step alone: a thread per CPU against a message to each executor.
+        std::vector<double> spawn, message;
+        std::atomic<std::uint32_t> sink { 0 };
+
+        for (int i = 0; i < reps; ++i) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<sys::Thread> threads(executors.size());
+            std::uint32_t n = 0;
+            for (const std::uint32_t cpu: executors.getCpus()) {
+                threads[n] = { [&sink]() { sink.fetch_add(1, std::memory_order_relaxed); return nullptr; } };
+                threads[n++].start({ cpu });
+            }
+            for (auto &thread: threads) {
+                thread.join();
+            }
+            spawn.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+
+            t0 = std::chrono::steady_clock::now();
+            executors.runOnAll([&sink](std::uint32_t) { sink.fetch_add(1, std::memory_order_relaxed); });
+            message.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+        }
+
+        std::sort(spawn.begin(), spawn.end());
+        std::sort(message.begin(), message.end());
+        std::printf("\nrun on every cpu: threads %.1f us, executors %.1f us (median)\n\n", spawn[spawn.size() / 2], message[message.size() / 2]);
+    }
+
+#if !defined(_MSC_VER)
+    char path[256];
+    std::snprintf(path, sizeof(path), "%s/probe_bench.%d.topology", std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp", static_cast<int>(getpid()));
+
+    { const sys::Processor writer { sys::ProbeBackend::Auto, path }; }
+
+    std::vector<double> samples;
+    bool match = true;
+
+    for (int i = 0; i < reps; ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const sys::Processor cpu { sys::ProbeBackend::Auto, path };
+        const auto t1 = std::chrono::steady_clock::now();
+
+        samples.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        match &= cpu.isCached() && sameTopology(cpu, reference);
+    }
+
+    report("cache", samples, match);
+    unlink(path);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef SYS_RELEASE_BARRIER_H
+#define SYS_RELEASE_BARRIER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "CpuSet.h"
+#include "Thread.h"
+
+// Lets pinned benchmark threads do their setup, then releases them together. Only threads that
+// actually started are waited for, so a CPU the process may not use costs a thread, not a hang.
+//
+//     ReleaseBarrier barrier;
+//     threads[i] = { [&]() { setup(); barrier.arrive(); work(); return nullptr; } };
+//     barrier.start(threads[i], cpus);
+//     ...
+//     const std::uint32_t running = barrier.release();
+class ReleaseBarrier {
+public:
+    // Starts the thread and counts it; false, and not counted, when it cannot be started.
+    bool            start(sys::Thread &thread, const sys::CpuSet &affinity) noexcept {
+        if (!thread.start(affinity)) {
+            return false;
+        }
+        ++started;
+        return true;
+    }
+
+    // Called by each started thread once it is ready; returns when release() is called.
+    void            arrive() noexcept {
+        arrived.fetch_add(1, std::memory_order_acq_rel);
+        while (!go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Waits until every started thread has arrived and releases them. Returns how many started.
+    std::uint32_t   release() noexcept {
+        while (arrived.load(std::memory_order_acquire) < started) {
+            std::this_thread::yield();
+        }
+        go.store(true, std::memory_order_release);
+        return started;
+    }
+
+private:
+    std::uint32_t               started { 0 };     // only touched by the starting thread
+    std::atomic<std::uint32_t>  arrived { 0 };
+    std::atomic<bool>           go { false };
+};
+
+#endif // SYS_RELEASE_BARRIER_H
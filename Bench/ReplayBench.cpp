@@ -0,0 +1,143 @@
+// Cost of planning for another machine: loading a CPUID dump and decoding a Processor from it.
+// Without arguments the dump of this machine is blown up into synthetic 2-socket to 16-socket
+// servers (64 threads per package), so large-machine decode cost can be measured anywhere.
+//
+// usage: replay_bench [dump...]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CpuidDump.h"
+#include "Processor.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double median(std::vector<double> samples) noexcept {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+template <class Fn>
+static double timeUs(int reps, Fn &&fn) noexcept {
+    std::vector<double> samples;
+    for (int i = 0; i < reps; ++i) {
+        const auto t0 = Clock::now();
+        fn();
+        samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+    return median(std::move(samples));
+}
+
+// `packages` packages of 32 two-thread cores, one node each. Every CPU is a copy of the source's
+// first CPU with its x2APIC id, topology leaf and cache sharing rewritten to match.
+static void synthesize(const sys::CpuidDump &source, std::uint32_t packages, sys::CpuidDump &out) noexcept {
+    constexpr std::uint32_t threadsPerPackage = 64;
+    const auto base = source.getEntries(source.getCpus().first());
+    const std::uint32_t cpus = packages * threadsPerPackage;
+    char path[96];
+
+    sys::Regs leaf0 {};
+    source.getReader(source.getCpus().first())->read(0, 0, leaf0);
+    const std::uint32_t cacheLeaf = leaf0.ebx == signature_AMD_ebx ? 0x8000001D : 4;
+
+    for (std::uint32_t cpu = 0; cpu < cpus; ++cpu) {
+        std::vector<sys::CpuidDump::Entry> entries;
+        for (sys::CpuidDump::Entry e: base) {
+            if (e.leaf == 0xB || e.leaf == 0x1F) {
+                continue;
+            }
+            if (e.leaf == 1) {
+                e.regs.ebx = (e.regs.ebx & 0x0000FFFF) | (std::min(threadsPerPackage, 255U) << 16) | ((cpu & 0xFF) << 24);
+            }
+            if (e.leaf == cacheLeaf && (e.regs.eax & 0x1F)) {
+                const std::uint32_t sharing = ((e.regs.eax >> 5) & 7) >= 3 ? threadsPerPackage : 2;
+                e.regs.eax = (e.regs.eax & ~0x03FFC000U) | ((sharing - 1) << 14);
+            }
+            entries.push_back(e);
+        }
+
+        // SMT shift 1, core shift 6, then the invalid level that ends the enumeration.
+        entries.push_back({ 0xB, 0, { 1, 2, 0x100, cpu } });
+        entries.push_back({ 0xB, 1, { 6, threadsPerPackage, 0x201, cpu } });
+        entries.push_back({ 0xB, 2, { 0, 0, 2, cpu } });
+        std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+            return a.leaf != b.leaf ? a.leaf < b.leaf : a.subleaf < b.subleaf;
+        });
+        out.setCpu(cpu, std::move(entries));
+
+        std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+        out.setFile(path, std::to_string(cpu / threadsPerPackage));
+    }
+
+    std::string distances;
+    out.setFile("/sys/devices/system/cpu/online", "0-" + std::to_string(cpus - 1));
+    out.setFile("/sys/devices/system/node/online", "0-" + std::to_string(packages - 1));
+    for (std::uint32_t node = 0; node < packages; ++node) {
+        distances.clear();
+        for (std::uint32_t to = 0; to < packages; ++to) {
+            distances += to ? (to == node ? " 10" : " 21") : (to == node ? "10" : "21");
+        }
+
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+        out.setFile(path, std::to_string(node * threadsPerPackage) + "-" + std::to_string((node + 1) * threadsPerPackage - 1));
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/meminfo", node);
+        out.setFile(path, "Node " + std::to_string(node) + " MemTotal:       67108864 kB\nNode " + std::to_string(node) + " MemFree:        33554432 kB");
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/distance", node);
+        out.setFile(path, distances);
+    }
+    out.setXcr0(source.getXcr0());
+}
+
+static void measure(const char *name, const char *path) noexcept {
+    constexpr int reps = 21;
+    sys::CpuidDump dump;
+    const double load = timeUs(reps, [&]() { dump.load(path); });
+    if (dump.getCpus().empty()) {
+        std::fprintf(stderr, "cannot read cpuid dump %s\n", path);
+        return;
+    }
+
+    std::size_t cores = 0;
+    const double decode = timeUs(reps, [&]() {
+        const sys::Processor cpu { dump };
+        cores = cpu.getCores().size();
+    });
+
+    std::printf("%-24s %6u cpus  load %10.1f us  decode %10.1f us  (%.2f us/cpu)\n", name, dump.getCpus().count(), load, decode,
+        (load + decode) / static_cast<double>(std::max<std::size_t>(cores, 1)));
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            measure(argv[i], argv[i]);
+        }
+        return 0;
+    }
+
+    sys::CpuidDump live;
+    if (!live.capture()) {
+        std::fprintf(stderr, "cannot capture cpuid\n");
+        return 1;
+    }
+
+    const std::string dir = std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp";
+    const std::string path = dir + "/replay_bench.cpuid";
+    live.save(path.c_str());
+    measure("this machine", path.c_str());
+
+    for (const std::uint32_t packages: { 2U, 8U, 16U }) {
+        sys::CpuidDump synthetic;
+        synthesize(live, packages, synthetic);
+        synthetic.save(path.c_str());
+
+        const std::string name = std::to_string(packages) + " x 64 synthetic";
+        measure(name.c_str(), path.c_str());
+    }
+    std::remove(path.c_str());
+    return 0;
+}
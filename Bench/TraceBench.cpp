@@ -0,0 +1,76 @@
+// Cost of recording a trace event, then a traced run on every CPU written as Chrome trace JSON
+// (open in ui.perfetto.dev or chrome://tracing).
+//
+// usage: trace_bench [out.json]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Thread.h"
+#include "Trace.h"
+
+int main(int argc, char **argv) {
+    const sys::Processor cpu;
+    const sys::TscClock clock { cpu };
+    const char *path = argc > 1 ? argv[1] : "trace.json";
+
+    const auto instant = sys::Tracer::defineEvent("instant");
+    const auto scope = sys::Tracer::defineEvent("scope");
+    const auto work = sys::Tracer::defineEvent("work");
+
+    // Touch the ring first, attaching is not part of the steady state cost.
+    sys::Tracer::instant(instant);
+
+    constexpr std::uint32_t iterations = 10'000'000;
+    std::vector<double> instants, scopes;
+    for (int run = 0; run < 5; ++run) {
+        auto t0 = clock.ticks();
+        for (std::uint32_t i = 0; i < iterations; ++i) {
+            sys::Tracer::instant(instant, i);
+        }
+        instants.push_back(static_cast<double>(clock.toNanos(clock.ticks() - t0)) / iterations);
+
+        t0 = clock.ticks();
+        for (std::uint32_t i = 0; i < iterations; ++i) {
+            sys::TraceScope s { scope, i };
+        }
+        scopes.push_back(static_cast<double>(clock.toNanos(clock.ticks() - t0)) / iterations / 2);
+    }
+    std::sort(instants.begin(), instants.end());
+    std::sort(scopes.begin(), scopes.end());
+    std::printf("ns per event: instant %.1f, scope begin/end %.1f (median of 5)\n", instants[2], scopes[2]);
+
+    // Discard the timing loops, then trace some work on every CPU.
+    sys::Tracer::writeChromeTrace(path, cpu, clock);
+
+    std::vector<sys::Thread> threads(cpu.getNumCores());
+    std::uint32_t i = 0;
+    for (const sys::LogicalCore &core: cpu.getCores()) {
+        threads[i] = {
+            [&, index = core.index]() {
+                volatile std::uint64_t sink = 0;
+                for (std::uint64_t n = 0; n < 20; ++n) {
+                    sys::TraceScope s { work, index };
+                    for (std::uint64_t k = 0; k < 100000 * (n % 4 + 1); ++k) {
+                        sink = sink + k;
+                    }
+                }
+                return nullptr;
+            }
+        };
+        threads[i].start(sys::CpuSet { core.index });
+        ++i;
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    if (!sys::Tracer::writeChromeTrace(path, cpu, clock)) {
+        std::fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    std::printf("wrote %s\n", path);
+    return 0;
+}
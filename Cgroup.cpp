@@ -0,0 +1,164 @@
+#include "Cgroup.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _MSC_VER
+#define strtok_r strtok_s
+#else
+#include <unistd.h>
+#endif
+
+#include "Sysfs.h"
+
+namespace sys {
+
+namespace {
+
+bool exists(const std::string &path) noexcept {
+#ifdef _MSC_VER
+    (void)path;
+    return false;
+#else
+    return access(path.c_str(), F_OK) == 0;
+#endif
+}
+
+// Directory of the group `path` under a controller mount. Without a cgroup namespace the path is
+// the host's, which does not exist inside a container whose mount is already its own group.
+std::string groupDir(const std::string &mount, const std::string &path) noexcept {
+    const std::string dir = mount + (path == "/" ? "" : path);
+    return exists(dir) ? dir : mount;
+}
+
+// Calls fn(dir) from `dir` up to and including `mount`.
+template <class Fn>
+void walkUp(const std::string &mount, std::string dir, Fn &&fn) noexcept {
+    for (;;) {
+        fn(dir);
+        if (dir.size() <= mount.size()) {
+            break;
+        }
+        dir.resize(dir.rfind('/'));
+    }
+}
+
+// v2 cpu.max: "max 100000" or "<quota> <period>".
+double readCpuMax(const std::string &dir) noexcept {
+    char buf[64];
+    if (!sysfs::readString((dir + "/cpu.max").c_str(), buf, sizeof(buf)) || !std::strncmp(buf, "max", 3)) {
+        return 0;
+    }
+    char *end;
+    const double quota = std::strtod(buf, &end);
+    const double period = std::strtod(end, nullptr);
+    return quota > 0 && period > 0 ? quota / period : 0;
+}
+
+// v1: cpu.cfs_quota_us is -1 when unlimited.
+double readCfsQuota(const std::string &dir) noexcept {
+    char buf[32];
+    std::uint64_t period;
+    if (!sysfs::readString((dir + "/cpu.cfs_quota_us").c_str(), buf, sizeof(buf)) ||
+        !sysfs::readUInt((dir + "/cpu.cfs_period_us").c_str(), period) || !period) {
+        return 0;
+    }
+    const double quota = std::strtod(buf, nullptr);
+    return quota > 0 ? quota / static_cast<double>(period) : 0;
+}
+
+}
+
+CpuBudget getCpuBudget(const CpuSet &affinity, const char *cgroupRoot, const char *selfCgroup) noexcept {
+    CpuBudget result;
+    result.cpus = affinity;
+
+    // "hierarchy-id:controller,list:/path" per line; v2 is the single "0::/path" line.
+    std::string v2Path, cpuPath, cpusetPath, cpuMount, cpusetMount;
+    if (std::FILE *file = std::fopen(selfCgroup, "r")) {
+        char line[4096];
+        while (std::fgets(line, sizeof(line), file)) {
+            line[std::strcspn(line, "\n")] = '\0';
+            char *controllers = std::strchr(line, ':');
+            char *path = controllers ? std::strchr(controllers + 1, ':') : nullptr;
+            if (!path) {
+                continue;
+            }
+            *path++ = '\0';
+            ++controllers;
+
+            if (!*controllers) {
+                v2Path = path;
+                continue;
+            }
+            // The mount directory is named after the whole co-mounted list, e.g. "cpu,cpuacct".
+            const std::string mount = std::string(cgroupRoot) + "/" + controllers;
+            for (char *save, *name = strtok_r(controllers, ",", &save); name; name = strtok_r(nullptr, ",", &save)) {
+                if (!std::strcmp(name, "cpu")) {
+                    cpuPath = path;
+                    cpuMount = mount;
+                } else if (!std::strcmp(name, "cpuset")) {
+                    cpusetPath = path;
+                    cpusetMount = mount;
+                }
+            }
+        }
+        std::fclose(file);
+    }
+
+    const std::string root = cgroupRoot;
+    CpuSet cpuset;
+    bool haveCpuset = false;
+    double quota = 0;
+    const auto limit = [&](double q) noexcept {
+        if (q > 0 && (quota == 0 || q < quota)) {
+            quota = q;
+        }
+    };
+
+    if (!cpuPath.empty() || !cpusetPath.empty()) {
+        // v1 (or the v1 half of a hybrid setup, where the cpu controllers are not on the unified tree).
+        result.cgroupVersion = 1;
+        if (!cpuPath.empty() && exists(cpuMount)) {
+            walkUp(cpuMount, groupDir(cpuMount, cpuPath), [&](const std::string &dir) { limit(readCfsQuota(dir)); });
+        }
+        if (!cpusetPath.empty() && exists(cpusetMount)) {
+            const std::string dir = groupDir(cpusetMount, cpusetPath);
+            haveCpuset = sysfs::readCpuList((dir + "/cpuset.effective_cpus").c_str(), cpuset) ||
+                         sysfs::readCpuList((dir + "/cpuset.cpus").c_str(), cpuset);
+        }
+    } else if (!v2Path.empty() && exists(root + "/cgroup.controllers")) {
+        result.cgroupVersion = 2;
+        walkUp(root, groupDir(root, v2Path), [&](const std::string &dir) {
+            limit(readCpuMax(dir));
+            // Nearest group with the cpuset controller enabled; its effective set already reflects the ancestors.
+            if (!haveCpuset) {
+                haveCpuset = sysfs::readCpuList((dir + "/cpuset.cpus.effective").c_str(), cpuset);
+            }
+        });
+    }
+
+    if (haveCpuset && !cpuset.empty()) {
+        CpuSet usable;
+        for (const std::uint32_t cpu: affinity) {
+            if (cpuset.test(cpu)) {
+                usable.set(cpu);
+            }
+        }
+        result.cpus = usable;
+    }
+
+    result.quota = quota;
+    result.budget = static_cast<double>(result.cpus.count());
+    if (quota > 0 && quota < result.budget) {
+        result.budget = quota;
+    }
+    result.parallelism = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(std::floor(result.budget + 1e-9)));
+    return result;
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#ifndef SYS_CGROUP_H
+#define SYS_CGROUP_H
+
+#include <cstdint>
+
+#include "CpuSet.h"
+
+namespace sys {
+
+// What the process may actually use, as opposed to what the machine has.
+struct CpuBudget {
+    CpuSet          cpus;           // affinity mask within the cgroup's cpuset.cpus.effective
+    double          quota { 0 };    // CFS bandwidth limit in CPUs (quota / period), 0 when unlimited
+    double          budget { 0 };   // CPUs the process can keep busy: cpus.count(), capped by quota
+    std::uint32_t   parallelism { 1 }; // threads to run without being throttled, floor(budget) and at least 1
+    std::uint32_t   cgroupVersion { 0 }; // 1 or 2, 0 when no cgroup was found
+};
+
+// Combines the affinity mask with the calling process's cgroup (v1 or v2): the cpuset of its own
+// group and the smallest CPU bandwidth limit on the path to the root. The roots are parameters so
+// a fake cgroupfs tree can stand in for the real one.
+CpuBudget           getCpuBudget(const CpuSet &affinity = CpuSet::fromAffinity(),
+                                 const char *cgroupRoot = "/sys/fs/cgroup",
+                                 const char *selfCgroup = "/proc/self/cgroup") noexcept;
+
+}
+
+#endif // SYS_CGROUP_H
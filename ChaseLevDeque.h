@@ -0,0 +1,140 @@
+#pragma once
+#ifndef SYS_CHASE_LEV_DEQUE_H
+#define SYS_CHASE_LEV_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "Processor.h"
+
+namespace sys {
+
+// Lock-free work-stealing deque (Chase & Lev, with the C11 orderings from Le et al. 2013).
+// The owner pushes and pops at the bottom, any thread may steal from the top.
+// Retired ring buffers are kept until destruction, thieves may still be reading them.
+template <class T>
+class ChaseLevDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "deque slots are read racily by thieves");
+
+public:
+    explicit        ChaseLevDeque(std::uint32_t capacity = 256) noexcept;
+
+                    ChaseLevDeque(const ChaseLevDeque &) = delete;
+    ChaseLevDeque & operator=(const ChaseLevDeque &) = delete;
+
+    // Owner only.
+    void            push(T value) noexcept;
+    bool            pop(T &value) noexcept;
+
+    // Any thread. Fails when empty or when it lost a race, callers just move on.
+    bool            steal(T &value) noexcept;
+
+    std::int64_t    size() const noexcept;
+
+private:
+    struct Ring {
+        std::int64_t                    mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+                        Ring(std::int64_t capacity) noexcept : mask{ capacity - 1 }, slots{ new std::atomic<T>[capacity] } {}
+
+        std::int64_t    capacity() const noexcept { return mask + 1; }
+        T               get(std::int64_t i) const noexcept { return slots[i & mask].load(std::memory_order_relaxed); }
+        void            put(std::int64_t i, T v) noexcept { slots[i & mask].store(v, std::memory_order_relaxed); }
+    };
+
+    Ring *          grow(Ring *ring, std::int64_t bottom, std::int64_t top) noexcept;
+
+    alignas(cacheLineAlign) std::atomic<std::int64_t> top { 0 };
+    alignas(cacheLineAlign) std::atomic<std::int64_t> bottom { 0 };
+    std::atomic<Ring *>                 ring;
+    std::vector<std::unique_ptr<Ring>>  rings;
+};
+
+template <class T>
+ChaseLevDeque<T>::ChaseLevDeque(std::uint32_t capacity) noexcept {
+    rings.push_back(std::make_unique<Ring>(std::bit_ceil(capacity < 2 ? 2U : capacity)));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+template <class T>
+void ChaseLevDeque<T>::push(T value) noexcept {
+    const std::int64_t b = bottom.load(std::memory_order_relaxed);
+    const std::int64_t t = top.load(std::memory_order_acquire);
+    Ring *r = ring.load(std::memory_order_relaxed);
+
+    if (b - t > r->capacity() - 1) {
+        r = grow(r, b, t);
+    }
+
+    r->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template <class T>
+bool ChaseLevDeque<T>::pop(T &value) noexcept {
+    const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring *r = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    value = r->get(b);
+
+    if (t == b) {
+        // Last element: race the thieves for it.
+        const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    return true;
+}
+
+template <class T>
+bool ChaseLevDeque<T>::steal(T &value) noexcept {
+    std::int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b) {
+        return false;
+    }
+
+    // Acquire stands in for consume here, the ring pointer must be read before its slot.
+    value = ring.load(std::memory_order_acquire)->get(t);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+template <class T>
+std::int64_t ChaseLevDeque<T>::size() const noexcept {
+    const std::int64_t b = bottom.load(std::memory_order_relaxed);
+    const std::int64_t t = top.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+}
+
+template <class T>
+typename ChaseLevDeque<T>::Ring * ChaseLevDeque<T>::grow(Ring *r, std::int64_t b, std::int64_t t) noexcept {
+    auto bigger = std::make_unique<Ring>(r->capacity() * 2);
+    for (std::int64_t i = t; i < b; ++i) {
+        bigger->put(i, r->get(i));
+    }
+
+    Ring *next = bigger.get();
+    rings.push_back(std::move(bigger));
+    ring.store(next, std::memory_order_release);
+    return next;
+}
+
+}
+
+#endif // SYS_CHASE_LEV_DEQUE_H
@@ -0,0 +1,182 @@
+#include "CpuExecutors.h"
+
+#include <algorithm>
+#include <bit>
+
+#if !defined(_MSC_VER)
+#include <sched.h>
+#endif
+
+namespace sys {
+
+thread_local CpuExecutors::Executor *CpuExecutors::current = nullptr;
+
+Mailbox::Mailbox(std::uint32_t capacity) noexcept {
+    const std::uint64_t size = std::bit_ceil(capacity < 2 ? 2U : capacity);
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+    for (std::uint64_t i = 0; i < size; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool Mailbox::runOne() noexcept {
+    Slot &slot = slots[head & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+        return false;
+    }
+
+    // Advanced first: the task may wait on other executors and run further tasks meanwhile.
+    const std::uint64_t pos = head++;
+    slot.task();
+    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+void CpuExecutors::Latch::countDown() noexcept {
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        remaining.notify_all();
+    }
+}
+
+void CpuExecutors::Latch::wait() noexcept {
+    for (auto r = remaining.load(std::memory_order_acquire); r; r = remaining.load(std::memory_order_acquire)) {
+        remaining.wait(r, std::memory_order_acquire);
+    }
+}
+
+CpuExecutors::CpuExecutors(const CpuSet &cpus, std::uint32_t mailboxSize) noexcept : cpus{ cpus } {
+    for (const std::uint32_t cpu: cpus) {
+        auto &e = executors.emplace_back(std::make_unique<Executor>(mailboxSize));
+        e->cpu = cpu;
+
+        if (lookup.size() <= cpu) {
+            lookup.resize(cpu + 1, nullptr);
+        }
+        lookup[cpu] = e.get();
+    }
+
+    for (auto &e: executors) {
+        Executor &self = *e;
+        self.thread = {
+            [this, &self]() {
+                run(self);
+                return nullptr;
+            }
+        };
+        // An offline or disallowed CPU gets no executor, so post() to it fails instead of hanging.
+        if (!self.thread.start({ self.cpu })) {
+            lookup[self.cpu] = nullptr;
+            this->cpus.reset(self.cpu);
+        }
+    }
+    std::erase_if(executors, [this](const std::unique_ptr<Executor> &e) { return !find(e->cpu); });
+}
+
+CpuExecutors::~CpuExecutors() {
+    stopping.store(true, std::memory_order_seq_cst);
+
+    for (auto &e: executors) {
+        e->wake.fetch_add(1, std::memory_order_seq_cst);
+        e->wake.notify_one();
+    }
+    for (auto &e: executors) {
+        e->thread.join();
+    }
+}
+
+std::uint32_t CpuExecutors::currentCpu() noexcept {
+    return current ? current->cpu : -1U;
+}
+
+void CpuExecutors::wait(Latch &latch) noexcept {
+    Executor *self = current;
+    if (!self || find(self->cpu) != self) {
+        latch.wait();
+        return;
+    }
+
+    // An executor waiting in a task keeps serving its mailbox: what it waits for may be waiting on it.
+    while (latch.remaining.load(std::memory_order_acquire)) {
+        if (!self->mailbox.runOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void CpuExecutors::notify(Executor &e) noexcept {
+    // Pairs with the fence in run(): either we see the sleeper or it sees the task.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (e.sleeping.load(std::memory_order_relaxed)) {
+        e.wake.fetch_add(1, std::memory_order_seq_cst);
+        e.wake.notify_one();
+    }
+}
+
+void CpuExecutors::run(Executor &self) noexcept {
+    current = &self;
+
+    for (;;) {
+        bool ran = false;
+        for (std::uint32_t spin = 0; !ran && spin < 64; ++spin) {
+            if (!(ran = self.mailbox.runOne())) {
+                std::this_thread::yield();
+            }
+        }
+        if (ran) {
+            continue;
+        }
+
+        self.sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::uint32_t w = self.wake.load(std::memory_order_seq_cst);
+
+        if (!self.mailbox.runOne()) {
+            if (stopping.load(std::memory_order_acquire)) {
+                break;
+            }
+            self.wake.wait(w, std::memory_order_seq_cst);
+        }
+        self.sleeping.store(0, std::memory_order_relaxed);
+    }
+
+    // Drain what was posted before shutdown so no caller is left waiting.
+    while (self.mailbox.runOne()) {
+    }
+    current = nullptr;
+}
+
+bool ExecutorProbe::run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept {
+    const std::uint32_t self = CpuExecutors::currentCpu();
+    CpuExecutors::Latch latch { static_cast<std::uint32_t>(cpus.size()) };
+    std::atomic<bool> ok { true };
+
+    for (std::uint32_t i = 0; i < cpus.size(); ++i) {
+        const std::uint32_t cpu = cpus[i];
+        const auto visit = [&visitor, &latch, &ok, i, cpu]() noexcept {
+#if !defined(_MSC_VER)
+            // The kernel resets a pinned thread's affinity when its CPU goes offline, after
+            // which CPUID would describe some other CPU.
+            if (sched_getcpu() != static_cast<int>(cpu)) {
+                ok.store(false, std::memory_order_relaxed);
+                latch.countDown();
+                return;
+            }
+#endif
+            visitor.visit(i, cpu, getNativeCpuidReader());
+            latch.countDown();
+        };
+
+        if (cpu == self) {
+            visit();
+        } else if (!executors.post(cpu, visit)) {
+            ok.store(false, std::memory_order_relaxed);
+            latch.countDown();
+        }
+    }
+
+    executors.wait(latch);
+    return ok.load(std::memory_order_relaxed);
+}
+
+}
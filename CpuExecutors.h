@@ -0,0 +1,237 @@
+#pragma once
+#ifndef SYS_CPU_EXECUTORS_H
+#define SYS_CPU_EXECUTORS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "CpuSet.h"
+#include "Processor.h"
+#include "Thread.h"
+#include "TopologyProbe.h"
+
+namespace sys {
+
+// Callable stored inline in a mailbox slot, no allocation. Larger callables should capture by
+// reference and use runOn(), which waits for them.
+class InlineTask {
+public:
+    static constexpr std::size_t    Capacity = 48;
+
+    template <class Fn>
+    void            emplace(Fn &&fn) noexcept;
+    // Runs and destroys the callable.
+    void            operator()() noexcept { invoke(storage); }
+
+private:
+    void          (*invoke)(void *storage) noexcept;
+    alignas(16) unsigned char storage[Capacity];
+};
+
+template <class Fn>
+void InlineTask::emplace(Fn &&fn) noexcept {
+    using T = std::decay_t<Fn>;
+    static_assert(sizeof(T) <= Capacity && alignof(T) <= 16, "callable too large for a mailbox slot, capture by reference");
+    static_assert(std::is_nothrow_move_constructible_v<T> || std::is_nothrow_copy_constructible_v<T>);
+
+    ::new (static_cast<void *>(storage)) T(std::forward<Fn>(fn));
+    invoke = [](void *p) noexcept {
+        T &f = *std::launder(static_cast<T *>(p));
+        f();
+        f.~T();
+    };
+}
+
+// Bounded lock-free MPSC queue (Vyukov's bounded queue with a single consumer): any thread
+// posts, only the owning executor pops.
+class Mailbox {
+public:
+    explicit        Mailbox(std::uint32_t capacity) noexcept;
+
+                    Mailbox(const Mailbox &) = delete;
+    Mailbox &       operator=(const Mailbox &) = delete;
+
+    // False when full.
+    template <class Fn>
+    bool            push(Fn &&fn) noexcept;
+    // Consumer only; runs the oldest task if there is one.
+    bool            runOne() noexcept;
+
+private:
+    struct alignas(cacheLineAlign) Slot {
+        std::atomic<std::uint64_t>  sequence;
+        InlineTask                  task;
+    };
+
+    std::unique_ptr<Slot[]>     slots;
+    std::uint64_t               mask;
+    alignas(cacheLineAlign) std::atomic<std::uint64_t> tail { 0 };
+    alignas(cacheLineAlign) std::uint64_t head { 0 };
+};
+
+template <class Fn>
+bool Mailbox::push(Fn &&fn) noexcept {
+    std::uint64_t pos = tail.load(std::memory_order_relaxed);
+    Slot *slot;
+
+    for (;;) {
+        slot = &slots[pos & mask];
+        const std::uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::int64_t>(seq - pos);
+
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->task.emplace(std::forward<Fn>(fn));
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+// One long-lived thread pinned to each CPU of a set, fed through its own mailbox. Running code
+// on a CPU is a queue push and, when the executor sleeps, one wakeup; no thread is created and
+// nothing is allocated per call.
+class CpuExecutors {
+public:
+    // Completion count a waiting caller blocks on.
+    struct Latch {
+        std::atomic<std::uint32_t>  remaining;
+
+        void        countDown() noexcept;
+        void        wait() noexcept;
+    };
+
+    explicit        CpuExecutors(const CpuSet &cpus = CpuSet::fromAffinity(), std::uint32_t mailboxSize = 256) noexcept;
+                    ~CpuExecutors();
+
+                    CpuExecutors(const CpuExecutors &) = delete;
+    CpuExecutors &  operator=(const CpuExecutors &) = delete;
+
+    // Queues fn() on the executor of cpu and returns; false if there is none. Waits while its mailbox is full.
+    template <class Fn>
+    bool            post(std::uint32_t cpu, Fn &&fn) noexcept;
+    // Runs fn() on cpu and waits for it. From an executor's own thread it simply calls fn.
+    template <class Fn>
+    bool            runOn(std::uint32_t cpu, Fn &&fn) noexcept;
+    // Runs fn(cpu) on every executor at once and waits for all of them.
+    template <class Fn>
+    void            runOnAll(Fn &&fn) noexcept;
+    // Waits for the latch. Called from a task, the executor runs its own mailbox meanwhile, so
+    // runOn() and runOnAll() may be nested in tasks without two executors waiting on each other.
+    void            wait(Latch &latch) noexcept;
+
+    const CpuSet &  getCpus() const noexcept { return cpus; }
+    std::uint32_t   size() const noexcept { return static_cast<std::uint32_t>(executors.size()); }
+    // CPU of the calling executor thread, -1U from any other thread.
+    static std::uint32_t currentCpu() noexcept;
+
+private:
+    struct alignas(cacheLineAlign) Executor {
+        explicit                    Executor(std::uint32_t mailboxSize) noexcept : mailbox{ mailboxSize } {}
+
+        std::uint32_t               cpu;
+        Mailbox                     mailbox;
+        Thread                      thread;
+
+        alignas(cacheLineAlign) std::atomic<std::uint32_t> sleeping { 0 };
+        std::atomic<std::uint32_t>  wake { 0 };
+    };
+
+    Executor *      find(std::uint32_t cpu) const noexcept { return cpu < lookup.size() ? lookup[cpu] : nullptr; }
+    void            notify(Executor &e) noexcept;
+    void            run(Executor &self) noexcept;
+
+    static thread_local Executor *      current;    // of the calling thread, any instance
+
+    CpuSet                              cpus;
+    std::vector<std::unique_ptr<Executor>> executors;
+    std::vector<Executor *>             lookup;     // by cpu number
+    std::atomic<bool>                   stopping { false };
+};
+
+template <class Fn>
+bool CpuExecutors::post(std::uint32_t cpu, Fn &&fn) noexcept {
+    Executor *e = find(cpu);
+    if (!e) {
+        return false;
+    }
+
+    while (!e->mailbox.push(std::forward<Fn>(fn))) {
+        std::this_thread::yield();
+    }
+    notify(*e);
+    return true;
+}
+
+template <class Fn>
+bool CpuExecutors::runOn(std::uint32_t cpu, Fn &&fn) noexcept {
+    if (!find(cpu)) {
+        return false;
+    }
+    if (currentCpu() == cpu) {
+        fn();
+        return true;
+    }
+
+    Latch latch { 1 };
+    post(cpu, [&fn, &latch]() noexcept {
+        fn();
+        latch.countDown();
+    });
+    wait(latch);
+    return true;
+}
+
+template <class Fn>
+void CpuExecutors::runOnAll(Fn &&fn) noexcept {
+    const std::uint32_t self = currentCpu();
+    Latch latch { size() };
+
+    for (const auto &e: executors) {
+        if (e->cpu != self) {
+            post(e->cpu, [&fn, &latch, cpu = e->cpu]() noexcept {
+                fn(cpu);
+                latch.countDown();
+            });
+        }
+    }
+
+    // Our own share inline, queueing it to ourselves would wait forever.
+    if (find(self)) {
+        fn(self);
+        latch.countDown();
+    }
+    wait(latch);
+}
+
+// Topology probe that visits each CPU on its executor, for repeated probes without thread creation.
+class ExecutorProbe final : public TopologyProbe {
+public:
+    explicit        ExecutorProbe(CpuExecutors &executors) noexcept : executors{ executors } {}
+
+    const char *    name() const noexcept override { return "executors"; }
+    bool            available() const noexcept override { return executors.size() != 0; }
+    bool            run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept override;
+
+private:
+    CpuExecutors &  executors;
+};
+
+}
+
+#endif // SYS_CPU_EXECUTORS_H
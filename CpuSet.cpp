@@ -0,0 +1,255 @@
+#include "CpuSet.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace sys {
+
+CpuSet::CpuSet(std::initializer_list<std::uint32_t> cpus) noexcept {
+    for (const std::uint32_t cpu: cpus) {
+        set(cpu);
+    }
+}
+
+CpuSet::CpuSet(const CpuSet &other) noexcept {
+    *this = other;
+}
+
+CpuSet::CpuSet(CpuSet &&other) noexcept {
+    *this = std::move(other);
+}
+
+CpuSet::~CpuSet() {
+    release();
+}
+
+CpuSet & CpuSet::operator=(const CpuSet &rhs) noexcept {
+    if (this != &rhs) {
+        clear();
+        if (rhs.numWords > numWords && !grow(rhs.numWords)) {
+            return *this;
+        }
+        std::memcpy(words(), rhs.words(), rhs.byteSize());
+    }
+    return *this;
+}
+
+CpuSet & CpuSet::operator=(CpuSet &&rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        std::memcpy(local, rhs.local, sizeof(local));
+        heap = rhs.heap;
+        numWords = rhs.numWords;
+
+        rhs.heap = nullptr;
+        rhs.numWords = InlineWords;
+        std::memset(rhs.local, 0, sizeof(rhs.local));
+    }
+    return *this;
+}
+
+CpuSet CpuSet::range(std::uint32_t first, std::uint32_t last) noexcept {
+    CpuSet set;
+    if (last > first) {
+        set.grow((last + BitsPerWord - 1) / BitsPerWord);
+    }
+    for (std::uint32_t cpu = first; cpu < last; ++cpu) {
+        set.set(cpu);
+    }
+    return set;
+}
+
+CpuSet CpuSet::fromAffinity() noexcept {
+    CpuSet set;
+#ifdef _MSC_VER
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        set.local[0] = processMask;
+    }
+#else
+    // The kernel rejects masks narrower than nr_cpu_ids with EINVAL, so widen until it fits.
+    while (sched_getaffinity(0, set.byteSize(), set.data()) != 0) {
+        if (errno != EINVAL || !set.grow(set.numWords * 2)) {
+            set.clear();
+            break;
+        }
+    }
+#endif
+    return set;
+}
+
+CpuSet CpuSet::fromList(const char *list) noexcept {
+    CpuSet set;
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        const auto first = static_cast<std::uint32_t>(std::strtoul(p, &end, 10));
+        if (end == p) {
+            break;
+        }
+
+        std::uint32_t last = first;
+        p = end;
+        if (*p == '-') {
+            last = static_cast<std::uint32_t>(std::strtoul(p + 1, &end, 10));
+            if (end == p + 1) {
+                break;
+            }
+            p = end;
+        }
+
+        for (std::uint32_t cpu = first; cpu <= last; ++cpu) {
+            set.set(cpu);
+        }
+
+        if (*p != ',') {
+            break;
+        }
+        ++p;
+    }
+
+    return set;
+}
+
+void CpuSet::clear() noexcept {
+    std::memset(words(), 0, byteSize());
+}
+
+std::uint32_t CpuSet::nth(std::uint32_t n) const noexcept {
+    const Word *w = words();
+    for (std::uint32_t i = 0; i < numWords; ++i) {
+        const auto bits = static_cast<std::uint32_t>(std::popcount(w[i]));
+        if (n < bits) {
+            Word word = w[i];
+            for (; n; --n) {
+                word &= word - 1;
+            }
+            return i * BitsPerWord + static_cast<std::uint32_t>(std::countr_zero(word));
+        }
+        n -= bits;
+    }
+    return npos;
+}
+
+bool CpuSet::intersects(const CpuSet &other) const noexcept {
+    const Word *a = words();
+    const Word *b = other.words();
+    const std::uint32_t n = std::min(numWords, other.numWords);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        if (a[i] & b[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CpuSet::isSubsetOf(const CpuSet &other) const noexcept {
+    const Word *a = words();
+    const Word *b = other.words();
+    for (std::uint32_t i = 0; i < numWords; ++i) {
+        if (a[i] & ~(i < other.numWords ? b[i] : 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CpuSet & CpuSet::operator|=(const CpuSet &rhs) noexcept {
+    if (rhs.numWords > numWords) {
+        grow(rhs.numWords);
+    }
+    Word *a = words();
+    const Word *b = rhs.words();
+    const std::uint32_t n = std::min(numWords, rhs.numWords);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        a[i] |= b[i];
+    }
+    return *this;
+}
+
+CpuSet & CpuSet::operator&=(const CpuSet &rhs) noexcept {
+    Word *a = words();
+    const Word *b = rhs.words();
+    for (std::uint32_t i = 0; i < numWords; ++i) {
+        a[i] &= i < rhs.numWords ? b[i] : 0;
+    }
+    return *this;
+}
+
+CpuSet & CpuSet::operator^=(const CpuSet &rhs) noexcept {
+    if (rhs.numWords > numWords) {
+        grow(rhs.numWords);
+    }
+    Word *a = words();
+    const Word *b = rhs.words();
+    const std::uint32_t n = std::min(numWords, rhs.numWords);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        a[i] ^= b[i];
+    }
+    return *this;
+}
+
+CpuSet & CpuSet::operator-=(const CpuSet &rhs) noexcept {
+    Word *a = words();
+    const Word *b = rhs.words();
+    const std::uint32_t n = std::min(numWords, rhs.numWords);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        a[i] &= ~b[i];
+    }
+    return *this;
+}
+
+bool CpuSet::operator==(const CpuSet &rhs) const noexcept {
+    const Word *a = words();
+    const Word *b = rhs.words();
+    const std::uint32_t n = std::max(numWords, rhs.numWords);
+    for (std::uint32_t i = 0; i < n; ++i) {
+        if ((i < numWords ? a[i] : 0) != (i < rhs.numWords ? b[i] : 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CpuSet::grow(std::uint32_t wordCount) noexcept {
+    if (wordCount <= numWords) {
+        return true;
+    }
+
+#ifdef _MSC_VER
+    Word *bits = new (std::nothrow) Word[wordCount] {};
+#else
+    auto *bits = reinterpret_cast<Word *>(CPU_ALLOC(wordCount * BitsPerWord));
+    if (bits) {
+        std::memset(bits, 0, CPU_ALLOC_SIZE(wordCount * BitsPerWord));
+    }
+#endif
+    if (!bits) {
+        return false;
+    }
+
+    std::memcpy(bits, words(), byteSize());
+    release();
+
+    heap = bits;
+    numWords = wordCount;
+    return true;
+}
+
+void CpuSet::release() noexcept {
+    if (heap) {
+#ifdef _MSC_VER
+        delete[] heap;
+#else
+        CPU_FREE(reinterpret_cast<cpu_set_t *>(heap));
+#endif
+        heap = nullptr;
+    }
+    numWords = InlineWords;
+}
+
+}
@@ -0,0 +1,190 @@
+#pragma once
+#ifndef SYS_CPU_SET_H
+#define SYS_CPU_SET_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sched.h>
+#endif
+
+namespace sys {
+
+// Set of logical CPU numbers with no upper bound. Machines with up to
+// InlineWords * BitsPerWord CPUs never touch the heap; above that the bits live
+// in a CPU_ALLOC'd block so data()/byteSize() can go straight to the affinity syscalls.
+class CpuSet {
+public:
+#ifdef _MSC_VER
+    using Word = std::uint64_t;
+#else
+    using Word = __cpu_mask;
+#endif
+
+    static constexpr std::uint32_t  BitsPerWord = sizeof(Word) * 8;
+    static constexpr std::uint32_t  InlineWords = 2;
+    static constexpr std::uint32_t  npos = -1U;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::uint32_t;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const std::uint32_t *;
+        using reference         = std::uint32_t;
+
+                        Iterator() noexcept = default;
+                        Iterator(const CpuSet *set, std::uint32_t cpu) noexcept : set{ set }, cpu{ cpu } {}
+
+        std::uint32_t   operator*() const noexcept { return cpu; }
+        Iterator &      operator++() noexcept { cpu = set->next(cpu + 1); return *this; }
+        Iterator        operator++(int) noexcept { Iterator it = *this; ++*this; return it; }
+        bool            operator==(const Iterator &rhs) const noexcept { return cpu == rhs.cpu; }
+
+    private:
+        const CpuSet *  set { nullptr };
+        std::uint32_t   cpu { npos };
+    };
+
+                    CpuSet() noexcept = default;
+                    CpuSet(std::initializer_list<std::uint32_t> cpus) noexcept;
+                    CpuSet(const CpuSet &other) noexcept;
+                    CpuSet(CpuSet &&other) noexcept;
+                    ~CpuSet();
+
+    CpuSet &        operator=(const CpuSet &rhs) noexcept;
+    CpuSet &        operator=(CpuSet &&rhs) noexcept;
+
+    // CPUs [first, last).
+    static CpuSet   range(std::uint32_t first, std::uint32_t last) noexcept;
+    // Affinity mask of the calling thread.
+    static CpuSet   fromAffinity() noexcept;
+    // Kernel cpulist format, e.g. "0-3,8,10-11". Parsing stops at the first malformed entry.
+    static CpuSet   fromList(const char *list) noexcept;
+
+    bool            set(std::uint32_t cpu) noexcept;
+    void            reset(std::uint32_t cpu) noexcept;
+    bool            test(std::uint32_t cpu) const noexcept;
+    void            clear() noexcept;
+
+    std::uint32_t   count() const noexcept;
+    bool            empty() const noexcept;
+    std::uint32_t   first() const noexcept { return next(0); }
+    std::uint32_t   next(std::uint32_t cpu) const noexcept;
+    std::uint32_t   nth(std::uint32_t n) const noexcept;
+
+    bool            intersects(const CpuSet &other) const noexcept;
+    bool            isSubsetOf(const CpuSet &other) const noexcept;
+
+    CpuSet &        operator|=(const CpuSet &rhs) noexcept;
+    CpuSet &        operator&=(const CpuSet &rhs) noexcept;
+    CpuSet &        operator^=(const CpuSet &rhs) noexcept;
+    CpuSet &        operator-=(const CpuSet &rhs) noexcept;
+
+    bool            operator==(const CpuSet &rhs) const noexcept;
+
+    Iterator        begin() const noexcept { return { this, first() }; }
+    Iterator        end() const noexcept { return { this, npos }; }
+
+    template <class Func>
+    void forEach(Func &&f) const noexcept {
+        const Word *w = words();
+        for (std::uint32_t i = 0; i < numWords; ++i) {
+            for (Word bits = w[i]; bits; bits &= bits - 1) {
+                f(i * BitsPerWord + static_cast<std::uint32_t>(std::countr_zero(bits)));
+            }
+        }
+    }
+
+    // Bits in use; the number of CPUs this set can describe without growing.
+    std::uint32_t   capacity() const noexcept { return numWords * BitsPerWord; }
+    std::size_t     byteSize() const noexcept { return numWords * sizeof(Word); }
+
+#ifndef _MSC_VER
+    const cpu_set_t *data() const noexcept { return reinterpret_cast<const cpu_set_t *>(words()); }
+    cpu_set_t *     data() noexcept { return reinterpret_cast<cpu_set_t *>(words()); }
+#endif
+
+    const Word *    words() const noexcept { return heap ? heap : local; }
+    Word *          words() noexcept { return heap ? heap : local; }
+    std::uint32_t   size() const noexcept { return numWords; }
+
+private:
+    bool            grow(std::uint32_t wordCount) noexcept;
+    void            release() noexcept;
+
+    Word            local[InlineWords] {};
+    Word *          heap { nullptr };
+    std::uint32_t   numWords { InlineWords };
+};
+
+inline CpuSet operator|(CpuSet lhs, const CpuSet &rhs) noexcept { return lhs |= rhs; }
+inline CpuSet operator&(CpuSet lhs, const CpuSet &rhs) noexcept { return lhs &= rhs; }
+inline CpuSet operator^(CpuSet lhs, const CpuSet &rhs) noexcept { return lhs ^= rhs; }
+inline CpuSet operator-(CpuSet lhs, const CpuSet &rhs) noexcept { return lhs -= rhs; }
+
+inline bool CpuSet::test(std::uint32_t cpu) const noexcept {
+    const std::uint32_t w = cpu / BitsPerWord;
+    return w < numWords && (words()[w] >> (cpu % BitsPerWord)) & 1;
+}
+
+inline void CpuSet::reset(std::uint32_t cpu) noexcept {
+    const std::uint32_t w = cpu / BitsPerWord;
+    if (w < numWords) {
+        words()[w] &= ~(Word { 1 } << (cpu % BitsPerWord));
+    }
+}
+
+inline bool CpuSet::set(std::uint32_t cpu) noexcept {
+    const std::uint32_t w = cpu / BitsPerWord;
+    if (w >= numWords && !grow(w + 1)) {
+        return false;
+    }
+    words()[w] |= Word { 1 } << (cpu % BitsPerWord);
+    return true;
+}
+
+inline std::uint32_t CpuSet::count() const noexcept {
+    const Word *w = words();
+    std::uint32_t n = 0;
+    for (std::uint32_t i = 0; i < numWords; ++i) {
+        n += static_cast<std::uint32_t>(std::popcount(w[i]));
+    }
+    return n;
+}
+
+inline bool CpuSet::empty() const noexcept {
+    const Word *w = words();
+    return std::all_of(w, w + numWords, [](Word bits) { return bits == 0; });
+}
+
+inline std::uint32_t CpuSet::next(std::uint32_t cpu) const noexcept {
+    std::uint32_t i = cpu / BitsPerWord;
+    if (i >= numWords) {
+        return npos;
+    }
+
+    const Word *w = words();
+    Word bits = w[i] & (~Word { 0 } << (cpu % BitsPerWord));
+
+    while (!bits) {
+        if (++i == numWords) {
+            return npos;
+        }
+        bits = w[i];
+    }
+
+    return i * BitsPerWord + static_cast<std::uint32_t>(std::countr_zero(bits));
+}
+
+}
+
+#endif // SYS_CPU_SET_H
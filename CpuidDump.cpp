@@ -0,0 +1,351 @@
+#include "CpuidDump.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include "Sysfs.h"
+
+namespace sys {
+
+namespace {
+
+constexpr const char *dumpMagic = "sys-cpuid-dump 1";
+
+// Topology files kept with a dump: what Processor reads, and what a person comparing machines wants to see.
+constexpr const char *cpuFiles[] = { "physical_package_id", "die_id", "core_id", "thread_siblings_list" };
+constexpr const char *nodeFiles[] = { "cpulist", "meminfo", "distance" };
+
+bool byLeaf(const CpuidDump::Entry &a, const CpuidDump::Entry &b) noexcept {
+    return a.leaf != b.leaf ? a.leaf < b.leaf : a.subleaf < b.subleaf;
+}
+
+void writeEscaped(std::FILE *file, const std::string &s) noexcept {
+    for (const char c: s) {
+        if (c == '\n') {
+            std::fputs("\\n", file);
+        } else if (c == '\\') {
+            std::fputs("\\\\", file);
+        } else {
+            std::fputc(c, file);
+        }
+    }
+}
+
+std::string unescape(const char *s) noexcept {
+    std::string out;
+    for (; *s; ++s) {
+        if (*s == '\\' && s[1]) {
+            ++s;
+            out.push_back(*s == 'n' ? '\n' : *s);
+        } else {
+            out.push_back(*s);
+        }
+    }
+    return out;
+}
+
+// Six space separated hex fields, the whole line. Hand rolled: strtoul() and sscanf() dominate
+// loading a large dump.
+bool parseEntry(const char *line, CpuidDump::Entry &e) noexcept {
+    std::uint32_t *fields[] = { &e.leaf, &e.subleaf, &e.regs.eax, &e.regs.ebx, &e.regs.ecx, &e.regs.edx };
+    for (std::uint32_t *field: fields) {
+        const char *start = line;
+        std::uint32_t value = 0;
+        for (;; ++line) {
+            const char c = *line;
+            if (c >= '0' && c <= '9') {
+                value = (value << 4) | static_cast<std::uint32_t>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                value = (value << 4) | static_cast<std::uint32_t>(c - 'a' + 10);
+            } else {
+                break;
+            }
+        }
+        if (line == start || line - start > 8) {
+            return false;
+        }
+        *field = value;
+        line += *line == ' ';
+    }
+    return *line == '\0';
+}
+
+}
+
+bool hasSubleaves(std::uint32_t leaf) noexcept {
+    switch (leaf) {
+    case 0x04: case 0x07: case 0x0B: case 0x0D: case 0x0F: case 0x10: case 0x12: case 0x14:
+    case 0x17: case 0x18: case 0x1B: case 0x1D: case 0x1E: case 0x1F: case 0x20: case 0x23: case 0x24:
+    case 0x8000001D: case 0x80000020: case 0x80000026:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void CpuidDump::Reader::index() noexcept {
+    std::sort(entries.begin(), entries.end(), byLeaf);
+
+    const auto max = [this](std::uint32_t base) noexcept {
+        Regs regs {};
+        return read(base, 0, regs) ? regs.eax : 0;
+    };
+    maxBasic = maxHypervisor = maxExtended = -1U;     // unbounded while the maxima are read
+    maxBasic = max(0);
+    maxHypervisor = max(0x40000000);
+    maxExtended = max(0x80000000);
+}
+
+bool CpuidDump::Reader::read(std::uint32_t leaf, std::uint32_t subleaf, Regs &regs) const noexcept {
+    const std::uint32_t limit = leaf >= 0x80000000 ? maxExtended : leaf >= 0x40000000 ? maxHypervisor : maxBasic;
+    regs = {};
+    if (leaf > limit) {
+        return false;
+    }
+
+    // Leaves without subleaves answer every ecx alike; subleaves not recorded were all zero.
+    const Entry key { leaf, hasSubleaves(leaf) ? subleaf : 0, {} };
+    const auto it = std::lower_bound(entries.begin(), entries.end(), key, byLeaf);
+    if (it != entries.end() && it->leaf == key.leaf && it->subleaf == key.subleaf) {
+        regs = it->regs;
+    }
+    return true;
+}
+
+bool CpuidDump::Probe::run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept {
+    std::uint32_t i = 0;
+    for (const std::uint32_t cpu: cpus) {
+        const CpuidReader *reader = dump.getReader(cpu);
+        if (!reader) {
+            return false;
+        }
+        visitor.visit(i++, cpu, *reader);
+    }
+    return true;
+}
+
+void CpuidDump::clear() noexcept {
+    cpus.clear();
+    readers.clear();
+    files.clear();
+    xcr0 = 0;
+}
+
+void CpuidDump::setCpu(std::uint32_t cpu, std::vector<Entry> entries) noexcept {
+    if (readers.size() <= cpu) {
+        readers.resize(cpu + 1);
+    }
+    readers[cpu].entries = std::move(entries);
+    readers[cpu].index();
+    cpus.set(cpu);
+}
+
+void CpuidDump::setFile(const char *path, std::string content) noexcept {
+    files.insert_or_assign(path, std::move(content));
+}
+
+std::span<const CpuidDump::Entry> CpuidDump::getEntries(std::uint32_t cpu) const noexcept {
+    if (cpu < readers.size()) {
+        return readers[cpu].entries;
+    }
+    return {};
+}
+
+const CpuidReader * CpuidDump::getReader(std::uint32_t cpu) const noexcept {
+    return cpus.test(cpu) ? &readers[cpu] : nullptr;
+}
+
+bool CpuidDump::readFile(const char *path, char *buf, std::size_t size) const noexcept {
+    const auto it = files.find(std::string_view { path });
+    if (it == files.end() || !size) {
+        return false;
+    }
+
+    const std::size_t n = std::min(it->second.size(), size - 1);
+    std::memcpy(buf, it->second.data(), n);
+    buf[n] = '\0';
+    return true;
+}
+
+bool CpuidDump::capture(ProbeBackend backend) noexcept {
+    const TopologyProbe *source = getTopologyProbe(backend == ProbeBackend::None ? ProbeBackend::Auto : backend);
+    const CpuSet affinity = CpuSet::fromAffinity();
+    const std::vector<std::uint32_t> list(affinity.begin(), affinity.end());
+    std::vector<std::vector<Entry>> captured(list.size());
+
+    ProbeFunc visit {
+        [&](std::uint32_t i, std::uint32_t, const CpuidReader &cpuid) {
+            std::vector<Entry> &out = captured[i];
+
+            const auto range = [&](std::uint32_t base) {
+                Regs regs {};
+                if (!cpuid.read(base, 0, regs) || regs.eax < base || regs.eax - base > 0xFF) {
+                    return;
+                }
+                for (std::uint32_t leaf = base, max = regs.eax; leaf <= max; ++leaf) {
+                    for (std::uint32_t sub = 0; sub < (hasSubleaves(leaf) ? 64U : 1U); ++sub) {
+                        // Past the last subleaf ecx still echoes the subleaf number in its low byte.
+                        if (cpuid.read(leaf, sub, regs) && (!sub || regs.eax || regs.ebx || regs.edx || (regs.ecx & ~0xFFU))) {
+                            out.push_back({ leaf, sub, regs });
+                        }
+                    }
+                }
+            };
+
+            range(0);
+            const auto leaf1 = std::find_if(out.begin(), out.end(), [](const Entry &e) { return e.leaf == 1; });
+            if (leaf1 != out.end() && (leaf1->regs.ecx & (1U << 31))) {
+                range(0x40000000);
+            }
+            range(0x80000000);
+        }
+    };
+
+    clear();
+    if (!source || !source->run(list, visit)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < list.size(); ++i) {
+        setCpu(list[i], std::move(captured[i]));
+    }
+
+    // XCR0 is per process rather than per CPU; this thread's is everyone's.
+    Regs leaf1 {};
+    if (getReader(list.front())->read(1, 0, leaf1) && (leaf1.ecx & (1U << 27))) {
+#ifdef _MSC_VER
+        xcr0 = _xgetbv(0);
+#else
+        std::uint32_t lo, hi;
+        __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = (static_cast<std::uint64_t>(hi) << 32) | lo;
+#endif
+    }
+
+    char path[128];
+    char buf[8192];
+    const auto keep = [&]() {
+        if (sysfs::readString(path, buf, sizeof(buf))) {
+            setFile(path, buf);
+        }
+    };
+
+    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/online");
+    keep();
+    for (const std::uint32_t cpu: list) {
+        for (const char *name: cpuFiles) {
+            std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/%s", cpu, name);
+            keep();
+        }
+    }
+
+    CpuSet nodes;
+    if (sysfs::readCpuList("/sys/devices/system/node/online", nodes)) {
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/online");
+        keep();
+        for (const std::uint32_t node: nodes) {
+            for (const char *name: nodeFiles) {
+                std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/%s", node, name);
+                keep();
+            }
+        }
+    }
+    return true;
+}
+
+bool CpuidDump::save(const char *path) const noexcept {
+    std::FILE *file = std::fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    std::fprintf(file, "%s\nxcr0 0x%" PRIx64 "\n", dumpMagic, xcr0);
+    for (const auto &[name, value]: files) {
+        std::fprintf(file, "file %s ", name.c_str());
+        writeEscaped(file, value);
+        std::fputc('\n', file);
+    }
+    for (const std::uint32_t cpu: cpus) {
+        std::fprintf(file, "cpu %u\n", cpu);
+        for (const Entry &e: readers[cpu].entries) {
+            std::fprintf(file, "%08x %02x %08x %08x %08x %08x\n", e.leaf, e.subleaf, e.regs.eax, e.regs.ebx, e.regs.ecx, e.regs.edx);
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+bool CpuidDump::load(const char *path) noexcept {
+    std::FILE *file = std::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    // The whole file in one read, then lines in place; a 1000 CPU dump is some 60k records.
+    std::string text;
+    if (!std::fseek(file, 0, SEEK_END)) {
+        text.resize(static_cast<std::size_t>(std::max(std::ftell(file), 0L)));
+        std::rewind(file);
+        text.resize(std::fread(text.data(), 1, text.size(), file));
+    }
+    std::fclose(file);
+
+    clear();
+    bool ok = true, first = true;
+    std::uint32_t cpu = -1U;
+    std::vector<Entry> entries;
+
+    const auto flush = [&]() {
+        if (cpu != -1U) {
+            const std::size_t count = entries.size();
+            setCpu(cpu, std::move(entries));
+            entries.clear();
+            entries.reserve(count);     // CPUs of a machine have about as many records each
+        }
+    };
+
+    if (!text.empty() && text.back() != '\n') {
+        text.push_back('\n');
+    }
+    for (std::size_t pos = 0; ok && pos < text.size();) {
+        const std::size_t end = text.find('\n', pos);
+        text[end] = '\0';
+        const char *line = text.c_str() + pos;
+        const std::size_t length = end - pos;
+        pos = end + 1;
+
+        Entry e {};
+        if (first) {
+            ok = std::string_view { line, length } == dumpMagic;
+            first = false;
+        } else if (!length || line[0] == '#') {
+            continue;
+        } else if (cpu != -1U && parseEntry(line, e)) {
+            entries.push_back(e);
+        } else if (!std::strncmp(line, "cpu ", 4)) {
+            flush();
+            cpu = static_cast<std::uint32_t>(std::strtoul(line + 4, nullptr, 10));
+        } else if (!std::strncmp(line, "xcr0 ", 5)) {
+            xcr0 = std::strtoull(line + 5, nullptr, 16);
+        } else if (!std::strncmp(line, "file ", 5)) {
+            const char *space = std::strchr(line + 5, ' ');
+            ok = space != nullptr;
+            if (ok) {
+                setFile(std::string(line + 5, space).c_str(), unescape(space + 1));
+            }
+        } else {
+            ok = false;
+        }
+    }
+    flush();
+
+    ok = ok && !first && !cpus.empty();
+    if (!ok) {
+        clear();
+    }
+    return ok;
+}
+
+}
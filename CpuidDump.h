@@ -0,0 +1,101 @@
+#pragma once
+#ifndef SYS_CPUID_DUMP_H
+#define SYS_CPUID_DUMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "CpuSet.h"
+#include "Processor.h"
+#include "TopologyProbe.h"
+
+namespace sys {
+
+// Every CPUID leaf and subleaf of every logical CPU, plus the sysfs files Processor reads, so a
+// Processor can be built for a machine other than the one it runs on:
+//
+//     cpuid --dump host.cpuid                  (on the host)
+//     sys::CpuidDump dump;
+//     dump.load("host.cpuid");
+//     const sys::Processor host { dump };      (anywhere)
+//
+// The file is line based text, one "leaf subleaf eax ebx ecx edx" record per line, so dumps of
+// a machine corpus diff and review like source.
+class CpuidDump {
+public:
+    struct Entry {
+        std::uint32_t   leaf;
+        std::uint32_t   subleaf;
+        Regs            regs;
+    };
+
+                    CpuidDump() noexcept : probe{ *this } {}
+
+                    CpuidDump(const CpuidDump &) = delete;
+    CpuidDump &     operator=(const CpuidDump &) = delete;
+
+    // Reads every CPU of the affinity mask through a probe backend, and the topology files.
+    bool            capture(ProbeBackend backend = ProbeBackend::Auto) noexcept;
+    bool            load(const char *path) noexcept;
+    bool            save(const char *path) const noexcept;
+
+    // Replaces (or adds) a CPU's records, e.g. to synthesize larger machines from a real one.
+    void            setCpu(std::uint32_t cpu, std::vector<Entry> entries) noexcept;
+    void            setFile(const char *path, std::string content) noexcept;
+    void            setXcr0(std::uint64_t value) noexcept { xcr0 = value; }
+
+    const CpuSet &  getCpus() const noexcept { return cpus; }
+    std::uint64_t   getXcr0() const noexcept { return xcr0; }
+    // Records of a CPU sorted by leaf and subleaf, empty when it was not captured.
+    std::span<const Entry> getEntries(std::uint32_t cpu) const noexcept;
+    // Answers as that CPU did; nullptr when it was not captured.
+    const CpuidReader *getReader(std::uint32_t cpu) const noexcept;
+    // Visits the captured CPUs with their readers, the backend a replayed Processor probes with.
+    const TopologyProbe &getProbe() const noexcept { return probe; }
+    // Captured content of a sysfs file, as sysfs::readString() would return it.
+    bool            readFile(const char *path, char *buf, std::size_t size) const noexcept;
+
+private:
+    class Reader final : public CpuidReader {
+    public:
+        std::vector<Entry>  entries;
+        std::uint32_t       maxBasic { 0 };
+        std::uint32_t       maxHypervisor { 0 };
+        std::uint32_t       maxExtended { 0 };
+
+        void        index() noexcept;
+        bool        read(std::uint32_t leaf, std::uint32_t subleaf, Regs &regs) const noexcept override;
+    };
+
+    class Probe final : public TopologyProbe {
+    public:
+        explicit    Probe(const CpuidDump &dump) noexcept : dump{ dump } {}
+
+        const char *name() const noexcept override { return "replay"; }
+        bool        available() const noexcept override { return !dump.cpus.empty(); }
+        bool        run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept override;
+
+    private:
+        const CpuidDump &dump;
+    };
+
+    void            clear() noexcept;
+
+    CpuSet                                          cpus;
+    std::vector<Reader>                             readers;    // by CPU number, empty for CPUs not captured
+    std::map<std::string, std::string, std::less<>> files;      // by path
+    std::uint64_t                                   xcr0 { 0 };
+    Probe                                           probe;
+};
+
+// Leaves whose output depends on the subleaf in ecx; every other leaf ignores it.
+bool                hasSubleaves(std::uint32_t leaf) noexcept;
+
+}
+
+#endif // SYS_CPUID_DUMP_H
@@ -0,0 +1,89 @@
+#include "Dispatch.h"
+
+#include "Kernels.h"
+
+namespace sys {
+
+static void * copyMemoryStub(void *dst, const void *src, std::size_t size) noexcept {
+    resolveKernels();
+    return copyMemory(dst, src, size);
+}
+
+static std::uint32_t crc32cStub(std::uint32_t crc, const void *data, std::size_t size) noexcept {
+    resolveKernels();
+    return crc32c(crc, data, size);
+}
+
+static std::uint64_t countBitsStub(const void *data, std::size_t size) noexcept {
+    resolveKernels();
+    return countBits(data, size);
+}
+
+// Constant initialised, so it is valid before any dynamic initialiser runs.
+constinit KernelTable kernels {
+    copyMemoryStub,
+    crc32cStub,
+    countBitsStub,
+};
+
+static std::atomic<Isa> kernelIsa { Isa::Scalar };
+
+Isa getIsa(const Processor &cpu) noexcept {
+    if (cpu.hasAVX512F() && cpu.hasAVX512BW() && cpu.hasAVX512DQ() && cpu.hasAVX512VL() &&
+        cpu.hasBMI1() && cpu.hasBMI2() && cpu.isAVX512Enabled()) {
+        return Isa::AVX512;
+    }
+    if (cpu.hasAVX2() && cpu.hasBMI1() && cpu.hasBMI2() && cpu.isAVXEnabled()) {
+        return Isa::AVX2;
+    }
+    if (cpu.hasSSE42() && cpu.hasPOPCNT()) {
+        return Isa::SSE42;
+    }
+    return Isa::Scalar;
+}
+
+const char * getIsaName(Isa isa) noexcept {
+    static const char *names[] = { "scalar", "sse4.2", "avx2", "avx512" };
+    return names[static_cast<std::uint32_t>(isa)];
+}
+
+template <class Fn>
+static Fn pick(const Fn (&impls)[numIsaLevels], Isa isa) noexcept {
+    for (auto level = static_cast<std::uint32_t>(isa); ; --level) {
+        if (impls[level] || level == 0) {
+            return impls[level];
+        }
+    }
+}
+
+static Isa getHostIsa() noexcept {
+    // Feature leaves are all we need, skip the topology probe.
+    static const Isa isa = getIsa(Processor { ProbeBackend::None });
+    return isa;
+}
+
+Isa resolveKernels() noexcept {
+    return resolveKernels(getHostIsa());
+}
+
+Isa resolveKernels(Isa isa) noexcept {
+    if (isa > getHostIsa()) {
+        isa = getHostIsa();
+    }
+
+    kernels.copyMemory.store(pick(copyMemoryImpls, isa), std::memory_order_relaxed);
+    kernels.crc32c.store(pick(crc32cImpls, isa), std::memory_order_relaxed);
+    kernels.countBits.store(pick(countBitsImpls, isa), std::memory_order_relaxed);
+    kernelIsa.store(isa, std::memory_order_relaxed);
+
+    return isa;
+}
+
+Isa getKernelIsa() noexcept {
+    return kernelIsa.load(std::memory_order_relaxed);
+}
+
+// Resolve at startup so the stubs are only ever hit by other static initialisers.
+[[maybe_unused]] static const Isa startupIsa = resolveKernels();
+
+}
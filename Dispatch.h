@@ -0,0 +1,63 @@
+#pragma once
+#ifndef SYS_DISPATCH_H
+#define SYS_DISPATCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Processor.h"
+
+namespace sys {
+
+// Instruction set levels kernels are built for, each implies the ones before it.
+enum class Isa : std::uint32_t {
+    Scalar,     // baseline x86-64
+    SSE42,      // SSE4.2 + POPCNT
+    AVX2,       // AVX2 + BMI1/2, YMM state enabled by the OS
+    AVX512,     // AVX-512 F/BW/DQ/VL, ZMM state enabled by the OS
+};
+
+inline constexpr std::uint32_t numIsaLevels = static_cast<std::uint32_t>(Isa::AVX512) + 1;
+
+Isa             getIsa(const Processor &cpu) noexcept;
+const char *    getIsaName(Isa isa) noexcept;
+
+using CopyMemoryFn  = void *        (*)(void *dst, const void *src, std::size_t size) noexcept;
+using Crc32cFn      = std::uint32_t (*)(std::uint32_t crc, const void *data, std::size_t size) noexcept;
+using CountBitsFn   = std::uint64_t (*)(const void *data, std::size_t size) noexcept;
+
+// Resolved kernels. Filled in during static initialisation from the host's feature bits; until
+// then every entry points at a stub that resolves the table on first use. Calls are a plain
+// indirect call afterwards, no feature test on the hot path.
+struct KernelTable {
+    std::atomic<CopyMemoryFn>   copyMemory;
+    std::atomic<Crc32cFn>       crc32c;
+    std::atomic<CountBitsFn>    countBits;
+};
+
+extern KernelTable kernels;
+
+// Best level for this machine, or a forced one (benchmarks, testing fallbacks). Levels without
+// an implementation of their own use the next lower one. Returns the level actually selected.
+Isa             resolveKernels() noexcept;
+Isa             resolveKernels(Isa isa) noexcept;
+Isa             getKernelIsa() noexcept;
+
+INLINE void * copyMemory(void *dst, const void *src, std::size_t size) noexcept {
+    return kernels.copyMemory.load(std::memory_order_relaxed)(dst, src, size);
+}
+
+// CRC-32C (Castagnoli), crc is the running value; pass 0 to start.
+INLINE std::uint32_t crc32c(std::uint32_t crc, const void *data, std::size_t size) noexcept {
+    return kernels.crc32c.load(std::memory_order_relaxed)(crc, data, size);
+}
+
+// Number of set bits in size bytes.
+INLINE std::uint64_t countBits(const void *data, std::size_t size) noexcept {
+    return kernels.countBits.load(std::memory_order_relaxed)(data, size);
+}
+
+}
+
+#endif // SYS_DISPATCH_H
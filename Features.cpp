@@ -0,0 +1,14 @@
+#include "Features.h"
+
+namespace sys {
+
+const char * getFeatureName(Feature feature) noexcept {
+    switch (feature) {
+#define SYS_FEATURE_NAME(name, word, bit) case Feature::name: return #name;
+    SYS_FEATURE_LIST(SYS_FEATURE_NAME)
+#undef SYS_FEATURE_NAME
+    }
+    return "unknown";
+}
+
+}
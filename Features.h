@@ -0,0 +1,317 @@
+#pragma once
+#ifndef SYS_FEATURES_H
+#define SYS_FEATURES_H
+
+#include <cstdint>
+
+namespace sys {
+
+// Each CPUID register holding feature flags is one 32 bit word of the Features bitset.
+enum FeatureWord : std::uint32_t {
+    Leaf1Ecx,           // 0x1 ecx
+    Leaf1Edx,           // 0x1 edx
+    Leaf6Eax,           // 0x6 eax, thermal and power management
+    Leaf7Ebx,           // 0x7.0 ebx
+    Leaf7Ecx,           // 0x7.0 ecx
+    Leaf7Edx,           // 0x7.0 edx
+    Leaf7S1Eax,         // 0x7.1 eax
+    Leaf7S1Edx,         // 0x7.1 edx
+    LeafDS1Eax,         // 0xD.1 eax, XSAVE extensions
+    Leaf14Ebx,          // 0x14.0 ebx, processor trace
+    Leaf14Ecx,          // 0x14.0 ecx, processor trace
+    Ext1Ecx,            // 0x80000001 ecx
+    Ext1Edx,            // 0x80000001 edx
+    Ext7Edx,            // 0x80000007 edx, advanced power management
+    Ext8Ebx,            // 0x80000008 ebx
+    NumFeatureWords,
+};
+
+// X(name, word, bit)
+#define SYS_FEATURE_LIST(X) \
+    X(SSE3, Leaf1Ecx, 0) X(PCLMULQDQ, Leaf1Ecx, 1) X(DTES64, Leaf1Ecx, 2) X(MONITOR, Leaf1Ecx, 3) \
+    X(DS_CPL, Leaf1Ecx, 4) X(VMX, Leaf1Ecx, 5) X(SMX, Leaf1Ecx, 6) X(EIST, Leaf1Ecx, 7) \
+    X(TM2, Leaf1Ecx, 8) X(SSSE3, Leaf1Ecx, 9) X(CNXT_ID, Leaf1Ecx, 10) X(SDBG, Leaf1Ecx, 11) \
+    X(FMA, Leaf1Ecx, 12) X(CX16, Leaf1Ecx, 13) X(XTPR, Leaf1Ecx, 14) X(PDCM, Leaf1Ecx, 15) \
+    X(PCID, Leaf1Ecx, 17) X(DCA, Leaf1Ecx, 18) X(SSE41, Leaf1Ecx, 19) X(SSE42, Leaf1Ecx, 20) \
+    X(X2APIC, Leaf1Ecx, 21) X(MOVBE, Leaf1Ecx, 22) X(POPCNT, Leaf1Ecx, 23) X(TSC_DEADLINE, Leaf1Ecx, 24) \
+    X(AES, Leaf1Ecx, 25) X(XSAVE, Leaf1Ecx, 26) X(OSXSAVE, Leaf1Ecx, 27) X(AVX, Leaf1Ecx, 28) \
+    X(F16C, Leaf1Ecx, 29) X(RDRAND, Leaf1Ecx, 30) X(HYPERVISOR, Leaf1Ecx, 31) \
+    \
+    X(FPU, Leaf1Edx, 0) X(VME, Leaf1Edx, 1) X(DE, Leaf1Edx, 2) X(PSE, Leaf1Edx, 3) \
+    X(TSC, Leaf1Edx, 4) X(MSR, Leaf1Edx, 5) X(PAE, Leaf1Edx, 6) X(MCE, Leaf1Edx, 7) \
+    X(CX8, Leaf1Edx, 8) X(APIC, Leaf1Edx, 9) X(SEP, Leaf1Edx, 11) X(MTRR, Leaf1Edx, 12) \
+    X(PGE, Leaf1Edx, 13) X(MCA, Leaf1Edx, 14) X(CMOV, Leaf1Edx, 15) X(PAT, Leaf1Edx, 16) \
+    X(PSE36, Leaf1Edx, 17) X(PSN, Leaf1Edx, 18) X(CLFSH, Leaf1Edx, 19) X(DS, Leaf1Edx, 21) \
+    X(ACPI, Leaf1Edx, 22) X(MMX, Leaf1Edx, 23) X(FXSR, Leaf1Edx, 24) X(SSE, Leaf1Edx, 25) \
+    X(SSE2, Leaf1Edx, 26) X(SS, Leaf1Edx, 27) X(HTT, Leaf1Edx, 28) X(TM, Leaf1Edx, 29) \
+    X(PBE, Leaf1Edx, 31) \
+    \
+    X(DTHERM, Leaf6Eax, 0) X(TURBO_BOOST, Leaf6Eax, 1) X(ARAT, Leaf6Eax, 2) X(PLN, Leaf6Eax, 4) \
+    X(ECMD, Leaf6Eax, 5) X(PTM, Leaf6Eax, 6) X(HWP, Leaf6Eax, 7) X(HWP_NOTIFY, Leaf6Eax, 8) \
+    X(HWP_ACT_WINDOW, Leaf6Eax, 9) X(HWP_EPP, Leaf6Eax, 10) X(HWP_PKG_REQ, Leaf6Eax, 11) X(HDC, Leaf6Eax, 13) \
+    X(TURBO_BOOST_MAX, Leaf6Eax, 14) X(HWP_CAPABILITIES, Leaf6Eax, 15) X(HWP_PECI_OVERRIDE, Leaf6Eax, 16) \
+    X(HWP_FLEXIBLE, Leaf6Eax, 17) X(HWP_FAST_ACCESS, Leaf6Eax, 18) X(HFI, Leaf6Eax, 19) \
+    X(HWP_IGNORE_IDLE, Leaf6Eax, 20) X(THREAD_DIRECTOR, Leaf6Eax, 23) \
+    \
+    X(FSGSBASE, Leaf7Ebx, 0) X(TSC_ADJUST, Leaf7Ebx, 1) X(SGX, Leaf7Ebx, 2) X(BMI1, Leaf7Ebx, 3) \
+    X(HLE, Leaf7Ebx, 4) X(AVX2, Leaf7Ebx, 5) X(FDP_EXCPTN_ONLY, Leaf7Ebx, 6) X(SMEP, Leaf7Ebx, 7) \
+    X(BMI2, Leaf7Ebx, 8) X(ERMS, Leaf7Ebx, 9) X(INVPCID, Leaf7Ebx, 10) X(RTM, Leaf7Ebx, 11) \
+    X(RDT_M, Leaf7Ebx, 12) X(FPU_CSDS, Leaf7Ebx, 13) X(MPX, Leaf7Ebx, 14) X(RDT_A, Leaf7Ebx, 15) \
+    X(AVX512F, Leaf7Ebx, 16) X(AVX512DQ, Leaf7Ebx, 17) X(RDSEED, Leaf7Ebx, 18) X(ADX, Leaf7Ebx, 19) \
+    X(SMAP, Leaf7Ebx, 20) X(AVX512_IFMA, Leaf7Ebx, 21) X(CLFLUSHOPT, Leaf7Ebx, 23) X(CLWB, Leaf7Ebx, 24) \
+    X(INTEL_PT, Leaf7Ebx, 25) X(AVX512PF, Leaf7Ebx, 26) X(AVX512ER, Leaf7Ebx, 27) X(AVX512CD, Leaf7Ebx, 28) \
+    X(SHA, Leaf7Ebx, 29) X(AVX512BW, Leaf7Ebx, 30) X(AVX512VL, Leaf7Ebx, 31) \
+    \
+    X(PREFETCHWT1, Leaf7Ecx, 0) X(AVX512_VBMI, Leaf7Ecx, 1) X(UMIP, Leaf7Ecx, 2) X(PKU, Leaf7Ecx, 3) \
+    X(OSPKE, Leaf7Ecx, 4) X(WAITPKG, Leaf7Ecx, 5) X(AVX512_VBMI2, Leaf7Ecx, 6) X(CET_SS, Leaf7Ecx, 7) \
+    X(GFNI, Leaf7Ecx, 8) X(VAES, Leaf7Ecx, 9) X(VPCLMULQDQ, Leaf7Ecx, 10) X(AVX512_VNNI, Leaf7Ecx, 11) \
+    X(AVX512_BITALG, Leaf7Ecx, 12) X(TME, Leaf7Ecx, 13) X(AVX512_VPOPCNTDQ, Leaf7Ecx, 14) X(LA57, Leaf7Ecx, 16) \
+    X(RDPID, Leaf7Ecx, 22) X(KL, Leaf7Ecx, 23) X(BUS_LOCK_DETECT, Leaf7Ecx, 24) X(CLDEMOTE, Leaf7Ecx, 25) \
+    X(MOVDIRI, Leaf7Ecx, 27) X(MOVDIR64B, Leaf7Ecx, 28) X(ENQCMD, Leaf7Ecx, 29) X(SGX_LC, Leaf7Ecx, 30) \
+    X(PKS, Leaf7Ecx, 31) \
+    \
+    X(SGX_KEYS, Leaf7Edx, 1) X(AVX512_4VNNIW, Leaf7Edx, 2) X(AVX512_4FMAPS, Leaf7Edx, 3) X(FSRM, Leaf7Edx, 4) \
+    X(UINTR, Leaf7Edx, 5) X(AVX512_VP2INTERSECT, Leaf7Edx, 8) X(SRBDS_CTRL, Leaf7Edx, 9) X(MD_CLEAR, Leaf7Edx, 10) \
+    X(RTM_ALWAYS_ABORT, Leaf7Edx, 11) X(TSX_FORCE_ABORT, Leaf7Edx, 13) X(SERIALIZE, Leaf7Edx, 14) \
+    X(HYBRID, Leaf7Edx, 15) X(TSXLDTRK, Leaf7Edx, 16) X(PCONFIG, Leaf7Edx, 18) X(ARCH_LBR, Leaf7Edx, 19) \
+    X(CET_IBT, Leaf7Edx, 20) X(AMX_BF16, Leaf7Edx, 22) X(AVX512_FP16, Leaf7Edx, 23) X(AMX_TILE, Leaf7Edx, 24) \
+    X(AMX_INT8, Leaf7Edx, 25) X(IBRS_IBPB, Leaf7Edx, 26) X(STIBP, Leaf7Edx, 27) X(L1D_FLUSH, Leaf7Edx, 28) \
+    X(ARCH_CAPABILITIES, Leaf7Edx, 29) X(CORE_CAPABILITIES, Leaf7Edx, 30) X(SSBD, Leaf7Edx, 31) \
+    \
+    X(SHA512, Leaf7S1Eax, 0) X(SM3, Leaf7S1Eax, 1) X(SM4, Leaf7S1Eax, 2) X(RAO_INT, Leaf7S1Eax, 3) \
+    X(AVX_VNNI, Leaf7S1Eax, 4) X(AVX512_BF16, Leaf7S1Eax, 5) X(LASS, Leaf7S1Eax, 6) X(CMPCCXADD, Leaf7S1Eax, 7) \
+    X(ARCH_PERFMON_EXT, Leaf7S1Eax, 8) X(FZLRM, Leaf7S1Eax, 10) X(FSRS, Leaf7S1Eax, 11) X(FSRCS, Leaf7S1Eax, 12) \
+    X(FRED, Leaf7S1Eax, 17) X(LKGS, Leaf7S1Eax, 18) X(WRMSRNS, Leaf7S1Eax, 19) X(AMX_FP16, Leaf7S1Eax, 21) \
+    X(HRESET, Leaf7S1Eax, 22) X(AVX_IFMA, Leaf7S1Eax, 23) X(LAM, Leaf7S1Eax, 26) X(MSRLIST, Leaf7S1Eax, 27) \
+    \
+    X(AVX_VNNI_INT8, Leaf7S1Edx, 4) X(AVX_NE_CONVERT, Leaf7S1Edx, 5) X(AMX_COMPLEX, Leaf7S1Edx, 8) \
+    X(AVX_VNNI_INT16, Leaf7S1Edx, 10) X(PREFETCHI, Leaf7S1Edx, 14) X(UIRET_UIF, Leaf7S1Edx, 17) \
+    X(CET_SSS, Leaf7S1Edx, 18) X(AVX10, Leaf7S1Edx, 19) X(APX_F, Leaf7S1Edx, 21) \
+    \
+    X(XSAVEOPT, LeafDS1Eax, 0) X(XSAVEC, LeafDS1Eax, 1) X(XGETBV_ECX1, LeafDS1Eax, 2) X(XSAVES, LeafDS1Eax, 3) \
+    X(XFD, LeafDS1Eax, 4) \
+    \
+    X(PT_CR3_FILTER, Leaf14Ebx, 0) X(PT_PSB_CYC, Leaf14Ebx, 1) X(PT_IP_FILTER, Leaf14Ebx, 2) X(PT_MTC, Leaf14Ebx, 3) \
+    X(PT_PTWRITE, Leaf14Ebx, 4) X(PT_POWER_EVENT, Leaf14Ebx, 5) X(PT_PSB_PMI, Leaf14Ebx, 6) \
+    X(PT_EVENT_TRACE, Leaf14Ebx, 7) X(PT_TNT_DISABLE, Leaf14Ebx, 8) \
+    X(PT_TOPA, Leaf14Ecx, 0) X(PT_TOPA_MULTI, Leaf14Ecx, 1) X(PT_SINGLE_RANGE, Leaf14Ecx, 2) \
+    X(PT_TRACE_TRANSPORT, Leaf14Ecx, 3) X(PT_LIP, Leaf14Ecx, 31) \
+    \
+    X(LAHF_LM, Ext1Ecx, 0) X(CMP_LEGACY, Ext1Ecx, 1) X(SVM, Ext1Ecx, 2) X(EXTAPIC, Ext1Ecx, 3) \
+    X(CR8_LEGACY, Ext1Ecx, 4) X(LZCNT, Ext1Ecx, 5) X(SSE4A, Ext1Ecx, 6) X(MISALIGNSSE, Ext1Ecx, 7) \
+    X(PREFETCHW, Ext1Ecx, 8) X(OSVW, Ext1Ecx, 9) X(IBS, Ext1Ecx, 10) X(XOP, Ext1Ecx, 11) \
+    X(SKINIT, Ext1Ecx, 12) X(WDT, Ext1Ecx, 13) X(LWP, Ext1Ecx, 15) X(FMA4, Ext1Ecx, 16) \
+    X(TCE, Ext1Ecx, 17) X(NODEID_MSR, Ext1Ecx, 19) X(TBM, Ext1Ecx, 21) X(TOPOEXT, Ext1Ecx, 22) \
+    X(PERFCTR_CORE, Ext1Ecx, 23) X(PERFCTR_NB, Ext1Ecx, 24) X(DBX, Ext1Ecx, 26) X(PERFTSC, Ext1Ecx, 27) \
+    X(PERFCTR_LLC, Ext1Ecx, 28) X(MWAITX, Ext1Ecx, 29) \
+    \
+    X(SYSCALL, Ext1Edx, 11) X(NX, Ext1Edx, 20) X(MMXEXT, Ext1Edx, 22) X(FXSR_OPT, Ext1Edx, 25) \
+    X(PDPE1GB, Ext1Edx, 26) X(RDTSCP, Ext1Edx, 27) X(LM, Ext1Edx, 29) X(AMD3DNOWEXT, Ext1Edx, 30) \
+    X(AMD3DNOW, Ext1Edx, 31) \
+    \
+    X(TS, Ext7Edx, 0) X(FID, Ext7Edx, 1) X(VID, Ext7Edx, 2) X(TTP, Ext7Edx, 3) X(TM_AMD, Ext7Edx, 4) \
+    X(STC, Ext7Edx, 5) X(STEPS_100MHZ, Ext7Edx, 6) X(HW_PSTATE, Ext7Edx, 7) X(INVARIANT_TSC, Ext7Edx, 8) \
+    X(CPB, Ext7Edx, 9) X(EFF_FREQ_RO, Ext7Edx, 10) X(PROC_FEEDBACK, Ext7Edx, 11) X(PROC_POWER_REPORT, Ext7Edx, 12) \
+    \
+    X(CLZERO, Ext8Ebx, 0) X(IRPERF, Ext8Ebx, 1) X(XSAVEERPTR, Ext8Ebx, 2) X(INVLPGB, Ext8Ebx, 3) \
+    X(RDPRU, Ext8Ebx, 4) X(MCOMMIT, Ext8Ebx, 8) X(WBNOINVD, Ext8Ebx, 9) X(AMD_IBPB, Ext8Ebx, 12) \
+    X(AMD_IBRS, Ext8Ebx, 14) X(AMD_STIBP, Ext8Ebx, 15) X(AMD_PPIN, Ext8Ebx, 23) X(AMD_SSBD, Ext8Ebx, 24)
+
+enum class Feature : std::uint32_t {
+#define SYS_FEATURE_ENUM(name, word, bit) name = (word) * 32 + (bit),
+    SYS_FEATURE_LIST(SYS_FEATURE_ENUM)
+#undef SYS_FEATURE_ENUM
+};
+
+const char *    getFeatureName(Feature feature) noexcept;
+
+// True when the compiler was told the feature is present (-mavx2, /arch:AVX2, ...). Code built
+// that way cannot run without it anyway, so a runtime check may as well be a constant.
+constexpr bool isBaselineFeature(Feature feature) noexcept {
+    switch (feature) {
+#if defined(__x86_64__) || defined(_M_X64)
+    case Feature::FPU: case Feature::TSC: case Feature::CX8: case Feature::CMOV:
+    case Feature::MMX: case Feature::FXSR: case Feature::SSE: case Feature::SSE2:
+    case Feature::LM: case Feature::SYSCALL:
+        return true;
+#endif
+#ifdef __SSE3__
+    case Feature::SSE3: return true;
+#endif
+#ifdef __SSSE3__
+    case Feature::SSSE3: return true;
+#endif
+#ifdef __SSE4_1__
+    case Feature::SSE41: return true;
+#endif
+#ifdef __SSE4_2__
+    case Feature::SSE42: return true;
+#endif
+#ifdef __POPCNT__
+    case Feature::POPCNT: return true;
+#endif
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+    case Feature::CX16: return true;
+#endif
+#ifdef __PCLMUL__
+    case Feature::PCLMULQDQ: return true;
+#endif
+#ifdef __AES__
+    case Feature::AES: return true;
+#endif
+#ifdef __MOVBE__
+    case Feature::MOVBE: return true;
+#endif
+#ifdef __XSAVE__
+    case Feature::XSAVE: return true;
+#endif
+#ifdef __AVX__
+    case Feature::AVX: return true;
+#endif
+#ifdef __F16C__
+    case Feature::F16C: return true;
+#endif
+#ifdef __FMA__
+    case Feature::FMA: return true;
+#endif
+#ifdef __RDRND__
+    case Feature::RDRAND: return true;
+#endif
+#ifdef __AVX2__
+    case Feature::AVX2: return true;
+#endif
+#ifdef __BMI__
+    case Feature::BMI1: return true;
+#endif
+#ifdef __BMI2__
+    case Feature::BMI2: return true;
+#endif
+#ifdef __LZCNT__
+    case Feature::LZCNT: return true;
+#endif
+#ifdef __PRFCHW__
+    case Feature::PREFETCHW: return true;
+#endif
+#ifdef __FSGSBASE__
+    case Feature::FSGSBASE: return true;
+#endif
+#ifdef __RDSEED__
+    case Feature::RDSEED: return true;
+#endif
+#ifdef __ADX__
+    case Feature::ADX: return true;
+#endif
+#ifdef __SHA__
+    case Feature::SHA: return true;
+#endif
+#ifdef __CLFLUSHOPT__
+    case Feature::CLFLUSHOPT: return true;
+#endif
+#ifdef __CLWB__
+    case Feature::CLWB: return true;
+#endif
+#ifdef __XSAVEOPT__
+    case Feature::XSAVEOPT: return true;
+#endif
+#ifdef __XSAVEC__
+    case Feature::XSAVEC: return true;
+#endif
+#ifdef __XSAVES__
+    case Feature::XSAVES: return true;
+#endif
+#ifdef __AVX512F__
+    case Feature::AVX512F: return true;
+#endif
+#ifdef __AVX512DQ__
+    case Feature::AVX512DQ: return true;
+#endif
+#ifdef __AVX512BW__
+    case Feature::AVX512BW: return true;
+#endif
+#ifdef __AVX512VL__
+    case Feature::AVX512VL: return true;
+#endif
+#ifdef __AVX512CD__
+    case Feature::AVX512CD: return true;
+#endif
+#ifdef __AVX512IFMA__
+    case Feature::AVX512_IFMA: return true;
+#endif
+#ifdef __AVX512VBMI__
+    case Feature::AVX512_VBMI: return true;
+#endif
+#ifdef __AVX512VBMI2__
+    case Feature::AVX512_VBMI2: return true;
+#endif
+#ifdef __AVX512VNNI__
+    case Feature::AVX512_VNNI: return true;
+#endif
+#ifdef __AVX512BITALG__
+    case Feature::AVX512_BITALG: return true;
+#endif
+#ifdef __AVX512VPOPCNTDQ__
+    case Feature::AVX512_VPOPCNTDQ: return true;
+#endif
+#ifdef __AVX512BF16__
+    case Feature::AVX512_BF16: return true;
+#endif
+#ifdef __AVX512FP16__
+    case Feature::AVX512_FP16: return true;
+#endif
+#ifdef __GFNI__
+    case Feature::GFNI: return true;
+#endif
+#ifdef __VAES__
+    case Feature::VAES: return true;
+#endif
+#ifdef __VPCLMULQDQ__
+    case Feature::VPCLMULQDQ: return true;
+#endif
+#ifdef __RDPID__
+    case Feature::RDPID: return true;
+#endif
+#ifdef __MOVDIRI__
+    case Feature::MOVDIRI: return true;
+#endif
+#ifdef __MOVDIR64B__
+    case Feature::MOVDIR64B: return true;
+#endif
+#ifdef __SERIALIZE__
+    case Feature::SERIALIZE: return true;
+#endif
+#ifdef __AVXVNNI__
+    case Feature::AVX_VNNI: return true;
+#endif
+#ifdef __AMX_TILE__
+    case Feature::AMX_TILE: return true;
+#endif
+#ifdef __AMX_INT8__
+    case Feature::AMX_INT8: return true;
+#endif
+#ifdef __AMX_BF16__
+    case Feature::AMX_BF16: return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+// Dense bitset over every flag above.
+class Features {
+public:
+    constexpr bool  test(Feature feature) const noexcept {
+        const auto i = static_cast<std::uint32_t>(feature);
+        return (words[i / 32] >> (i % 32)) & 1;
+    }
+
+    constexpr void  set(Feature feature) noexcept {
+        const auto i = static_cast<std::uint32_t>(feature);
+        words[i / 32] |= 1U << (i % 32);
+    }
+
+    std::uint32_t   words[NumFeatureWords] {};
+};
+
+}
+
+#endif // SYS_FEATURES_H
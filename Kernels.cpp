@@ -0,0 +1,240 @@
+#include "Kernels.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#define TARGET(isa)
+#else
+#include <x86intrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// Each kernel is compiled for its level with a target attribute, so the library itself can be
+// built for baseline x86-64 and still carry AVX-512 code paths.
+#define TARGET_SSE42    TARGET("sse4.2,popcnt")
+#define TARGET_AVX2     TARGET("avx2,bmi,bmi2,popcnt")
+#define TARGET_AVX512   TARGET("avx512f,avx512bw,avx512dq,avx512vl,bmi,bmi2,popcnt")
+
+namespace sys {
+
+// copyMemory
+
+static void * copyMemoryScalar(void *dst, const void *src, std::size_t size) noexcept {
+    auto *d = static_cast<unsigned char *>(dst);
+    auto *s = static_cast<const unsigned char *>(src);
+
+    for (; size >= 8; size -= 8, d += 8, s += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, s, 8);
+        std::memcpy(d, &w, 8);
+    }
+    while (size--) {
+        *d++ = *s++;
+    }
+    return dst;
+}
+
+TARGET_SSE42 static void * copyMemorySSE42(void *dst, const void *src, std::size_t size) noexcept {
+    auto *d = static_cast<unsigned char *>(dst);
+    auto *s = static_cast<const unsigned char *>(src);
+
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 32));
+        const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 16), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 32), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d + 48), e);
+    }
+    copyMemoryScalar(d, s, size);
+    return dst;
+}
+
+TARGET_AVX2 static void * copyMemoryAVX2(void *dst, const void *src, std::size_t size) noexcept {
+    auto *d = static_cast<unsigned char *>(dst);
+    auto *s = static_cast<const unsigned char *>(src);
+
+    for (; size >= 128; size -= 128, d += 128, s += 128) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 64));
+        const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 96));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 32), b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 64), c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 96), e);
+    }
+    for (; size >= 32; size -= 32, d += 32, s += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)));
+    }
+    copyMemoryScalar(d, s, size);
+    return dst;
+}
+
+TARGET_AVX512 static void * copyMemoryAVX512(void *dst, const void *src, std::size_t size) noexcept {
+    auto *d = static_cast<unsigned char *>(dst);
+    auto *s = static_cast<const unsigned char *>(src);
+
+    for (; size >= 256; size -= 256, d += 256, s += 256) {
+        const __m512i a = _mm512_loadu_si512(s);
+        const __m512i b = _mm512_loadu_si512(s + 64);
+        const __m512i c = _mm512_loadu_si512(s + 128);
+        const __m512i e = _mm512_loadu_si512(s + 192);
+        _mm512_storeu_si512(d, a);
+        _mm512_storeu_si512(d + 64, b);
+        _mm512_storeu_si512(d + 128, c);
+        _mm512_storeu_si512(d + 192, e);
+    }
+    for (; size >= 64; size -= 64, d += 64, s += 64) {
+        _mm512_storeu_si512(d, _mm512_loadu_si512(s));
+    }
+    if (size) {
+        // Masked tail, no byte loop.
+        const __mmask64 mask = _bzhi_u64(~0ULL, static_cast<unsigned>(size));
+        _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+    }
+    return dst;
+}
+
+// crc32c
+
+static constexpr std::array<std::uint32_t, 256> crc32cTable = [] {
+    std::array<std::uint32_t, 256> table {};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t crc = i;
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0U - (crc & 1)));
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+static std::uint32_t crc32cScalar(std::uint32_t crc, const void *data, std::size_t size) noexcept {
+    auto *p = static_cast<const unsigned char *>(data);
+
+    crc = ~crc;
+    while (size--) {
+        crc = crc32cTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+TARGET_SSE42 static std::uint32_t crc32cSSE42(std::uint32_t crc, const void *data, std::size_t size) noexcept {
+    auto *p = static_cast<const unsigned char *>(data);
+    std::uint64_t c = ~crc;
+
+    for (; size >= 8; size -= 8, p += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+    }
+
+    auto c32 = static_cast<std::uint32_t>(c);
+    while (size--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return ~c32;
+}
+
+// countBits
+
+static std::uint64_t countBitsScalar(const void *data, std::size_t size) noexcept {
+    auto *p = static_cast<const unsigned char *>(data);
+    std::uint64_t total = 0;
+
+    for (; size >= 8; size -= 8, p += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, p, 8);
+        w = w - ((w >> 1) & 0x5555555555555555ULL);
+        w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+        w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        total += (w * 0x0101010101010101ULL) >> 56;
+    }
+    while (size--) {
+        for (unsigned b = *p++; b; b &= b - 1) {
+            ++total;
+        }
+    }
+    return total;
+}
+
+TARGET_SSE42 static std::uint64_t countBitsSSE42(const void *data, std::size_t size) noexcept {
+    auto *p = static_cast<const unsigned char *>(data);
+    std::uint64_t total = 0;
+
+    for (; size >= 8; size -= 8, p += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, p, 8);
+        total += static_cast<std::uint64_t>(_mm_popcnt_u64(w));
+    }
+    while (size--) {
+        total += static_cast<std::uint64_t>(_mm_popcnt_u32(*p++));
+    }
+    return total;
+}
+
+// Nibble lookup with PSHUFB, bytes summed with PSADBW (Mula, Kurz, Lemire).
+TARGET_AVX2 static std::uint64_t countBitsAVX2(const void *data, std::size_t size) noexcept {
+    auto *p = static_cast<const unsigned char *>(data);
+
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i acc = _mm256_setzero_si256();
+
+    for (; size >= 32; size -= 32, p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        const __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+        const __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+
+    std::uint64_t total = static_cast<std::uint64_t>(_mm256_extract_epi64(acc, 0)) + static_cast<std::uint64_t>(_mm256_extract_epi64(acc, 1)) +
+                          static_cast<std::uint64_t>(_mm256_extract_epi64(acc, 2)) + static_cast<std::uint64_t>(_mm256_extract_epi64(acc, 3));
+    return total + countBitsSSE42(p, size);
+}
+
+TARGET_AVX512 static std::uint64_t countBitsAVX512(const void *data, std::size_t size) noexcept {
+    auto *p = static_cast<const unsigned char *>(data);
+
+    const __m512i lookup = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low = _mm512_set1_epi8(0x0F);
+    __m512i acc = _mm512_setzero_si512();
+
+    for (; size >= 64; size -= 64, p += 64) {
+        const __m512i v = _mm512_loadu_si512(p);
+        const __m512i lo = _mm512_shuffle_epi8(lookup, _mm512_and_si512(v, low));
+        const __m512i hi = _mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(v, 4), low));
+        acc = _mm512_add_epi64(acc, _mm512_sad_epu8(_mm512_add_epi8(lo, hi), _mm512_setzero_si512()));
+    }
+
+    return static_cast<std::uint64_t>(_mm512_reduce_add_epi64(acc)) + countBitsSSE42(p, size);
+}
+
+const CopyMemoryFn copyMemoryImpls[numIsaLevels] = {
+    copyMemoryScalar,
+    copyMemorySSE42,
+    copyMemoryAVX2,
+    copyMemoryAVX512,
+};
+
+const Crc32cFn crc32cImpls[numIsaLevels] = {
+    crc32cScalar,
+    crc32cSSE42,
+    nullptr,
+    nullptr,
+};
+
+const CountBitsFn countBitsImpls[numIsaLevels] = {
+    countBitsScalar,
+    countBitsSSE42,
+    countBitsAVX2,
+    countBitsAVX512,
+};
+
+}
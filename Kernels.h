@@ -0,0 +1,16 @@
+#pragma once
+#ifndef SYS_KERNELS_H
+#define SYS_KERNELS_H
+
+#include "Dispatch.h"
+
+namespace sys {
+
+// Per level implementations, indexed by Isa. nullptr where a level brings nothing new.
+extern const CopyMemoryFn   copyMemoryImpls[numIsaLevels];
+extern const Crc32cFn       crc32cImpls[numIsaLevels];
+extern const CountBitsFn    countBitsImpls[numIsaLevels];
+
+}
+
+#endif // SYS_KERNELS_H
@@ -0,0 +1,313 @@
+#include "NumaAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Sysfs.h"
+#include "Thread.h"
+
+namespace sys {
+
+namespace {
+
+INLINE std::uintptr_t alignUp(std::uintptr_t value, std::size_t align) noexcept {
+    return (value + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+}
+
+}
+
+bool bindMemory(void *address, std::size_t size, std::uint32_t node, bool strict) noexcept {
+#ifdef _MSC_VER
+    (void)address; (void)size; (void)node; (void)strict;
+    return false;
+#else
+    constexpr int mpolPreferred = 1, mpolBind = 2;
+    constexpr std::uint32_t bits = sizeof(unsigned long) * 8;
+
+    std::vector<unsigned long> mask(node / bits + 1);
+    mask[node / bits] = 1UL << (node % bits);
+    return syscall(SYS_mbind, address, size, strict ? mpolBind : mpolPreferred, mask.data(), mask.size() * bits + 1, 0) == 0;
+#endif
+}
+
+std::uint32_t getPageNode(const void *address) noexcept {
+#ifdef _MSC_VER
+    (void)address;
+    return -1U;
+#else
+    void *page = const_cast<void *>(address);
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) != 0 || status < 0) {
+        return -1U;
+    }
+    return static_cast<std::uint32_t>(status);
+#endif
+}
+
+NumaAllocator::NumaAllocator(const Processor &cpu, HugePages hugePages, std::size_t chunkSize) noexcept
+    : cpu{ cpu }, hugePages{ hugePages }, placement{ NodePlacement::Local } {
+    lineSize = cpu.getCacheLineSize() ? cpu.getCacheLineSize() : cacheLineAlign;
+
+#ifdef _MSC_VER
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pageSize = info.dwPageSize;
+    hugePageSize = GetLargePageMinimum() ? GetLargePageMinimum() : 2 << 20;
+#else
+    pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::uint64_t pmdSize = 0;
+    hugePageSize = sysfs::readUInt("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", pmdSize) && pmdSize ? pmdSize : 2 << 20;
+#endif
+
+    // Chunks are aligned to their (power of two) size so a block finds its chunk header by masking.
+    const std::size_t minChunk = hugePages == HugePages::None ? std::max<std::size_t>(pageSize, 64 << 10) : hugePageSize;
+    this->chunkSize = std::bit_ceil(std::max(chunkSize, minChunk));
+
+    // Two classes per doubling: line multiples below a page, page multiples from there.
+    const std::size_t maxSmall = std::min<std::size_t>(this->chunkSize / 8, 256 << 10);
+    for (std::size_t size = lineSize; size <= maxSmall;) {
+        classes.push_back(size);
+        const std::size_t granule = size >= pageSize ? pageSize : lineSize;
+        size = alignUp(size + std::max(granule, std::bit_floor(size) / 2), granule);
+    }
+
+    for (const NumaNode &node: cpu.getNumaNodes()) {
+        auto arena = std::make_unique<Arena>();
+        arena->node = node.id;
+        arena->cpus = node.cpus;
+        arenas.push_back(std::move(arena));
+    }
+    if (arenas.empty()) {
+        auto arena = std::make_unique<Arena>();
+        arena->node = 0;
+        arena->cpus = CpuSet::fromAffinity();
+        arenas.push_back(std::move(arena));
+    }
+
+    for (auto &arena: arenas) {
+        arena->freeLists.resize(classes.size());
+        byNode.resize(std::max<std::size_t>(byNode.size(), arena->node + 1));
+        byNode[arena->node] = arena.get();
+    }
+
+    // mbind may be refused (seccomp, a container without CAP_SYS_NICE on some kernels); try it once.
+    if (arenas.size() > 1) {
+        placement = NodePlacement::FirstTouch;
+#ifndef _MSC_VER
+        void *probe = mmap(nullptr, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (probe != MAP_FAILED) {
+            if (bindMemory(probe, pageSize, arenas.front()->node, true)) {
+                placement = NodePlacement::Bind;
+            }
+            munmap(probe, pageSize);
+        }
+#endif
+    }
+}
+
+NumaAllocator::~NumaAllocator() {
+    for (const auto &arena: arenas) {
+        for (void *chunk: arena->chunks) {
+            unmap(chunk, chunkSize);
+        }
+    }
+}
+
+std::uint32_t NumaAllocator::getClass(std::size_t size) const noexcept {
+    return static_cast<std::uint32_t>(std::lower_bound(classes.begin(), classes.end(), size) - classes.begin());
+}
+
+std::size_t NumaAllocator::getBlockSize(std::size_t size) const noexcept {
+    if (size > getMaxSmallSize()) {
+        return alignUp(size, hugePages != HugePages::None && size >= hugePageSize ? hugePageSize : pageSize);
+    }
+    return classes[getClass(size)];
+}
+
+std::size_t NumaAllocator::getMappedBytes(std::uint32_t node) const noexcept {
+    Arena *arena = find(node);
+    if (!arena) {
+        return 0;
+    }
+    std::lock_guard lock { arena->mutex };
+    return arena->mapped;
+}
+
+void * NumaAllocator::allocate(std::size_t size) noexcept {
+    const LogicalCore *core = cpu.currentCore();
+    const std::uint32_t node = core && find(core->node) ? core->node : arenas.front()->node;
+    return allocate(size, node);
+}
+
+void * NumaAllocator::allocate(std::size_t size, std::uint32_t node) noexcept {
+    Arena *arena = find(node);
+    if (!arena) {
+        return nullptr;
+    }
+
+    if (size > getMaxSmallSize()) {
+        const std::size_t blockSize = getBlockSize(size);
+        void *block = map(*arena, blockSize, blockSize % hugePageSize ? pageSize : hugePageSize);
+        if (block) {
+            std::lock_guard lock { arena->mutex };
+            arena->mapped += blockSize;
+        }
+        return block;
+    }
+
+    const std::uint32_t index = getClass(std::max<std::size_t>(size, 1));
+    const std::size_t blockSize = classes[index];
+    const std::size_t align = blockSize >= pageSize ? pageSize : lineSize;
+
+    std::lock_guard lock { arena->mutex };
+
+    if (void *block = arena->freeLists[index]) {
+        arena->freeLists[index] = *static_cast<void **>(block);
+        return block;
+    }
+
+    auto *block = reinterpret_cast<unsigned char *>(alignUp(reinterpret_cast<std::uintptr_t>(arena->cursor), align));
+    if (!arena->cursor || block + blockSize > arena->limit) {
+        auto *chunk = static_cast<unsigned char *>(map(*arena, chunkSize, chunkSize));
+        if (!chunk) {
+            return nullptr;
+        }
+        ::new (chunk) ChunkHeader { arena->node };
+        arena->chunks.push_back(chunk);
+        arena->mapped += chunkSize;
+        arena->limit = chunk + chunkSize;
+        block = reinterpret_cast<unsigned char *>(alignUp(reinterpret_cast<std::uintptr_t>(chunk + sizeof(ChunkHeader)), align));
+    }
+    arena->cursor = block + blockSize;
+    return block;
+}
+
+void NumaAllocator::deallocate(void *block, std::size_t size) noexcept {
+    if (!block) {
+        return;
+    }
+
+    if (size > getMaxSmallSize()) {
+        const std::size_t blockSize = getBlockSize(size);
+        const std::uint32_t node = getPageNode(block);
+        unmap(block, blockSize);
+
+        // The block's own node, as mapped; the first arena when the kernel does not say.
+        Arena *arena = find(node) ? find(node) : arenas.front().get();
+        std::lock_guard lock { arena->mutex };
+        arena->mapped -= std::min(arena->mapped, blockSize);
+        return;
+    }
+
+    const auto *header = reinterpret_cast<const ChunkHeader *>(reinterpret_cast<std::uintptr_t>(block) & ~static_cast<std::uintptr_t>(chunkSize - 1));
+    Arena *arena = find(header->node);
+    const std::uint32_t index = getClass(std::max<std::size_t>(size, 1));
+
+    std::lock_guard lock { arena->mutex };
+    *static_cast<void **>(block) = arena->freeLists[index];
+    arena->freeLists[index] = block;
+}
+
+void * NumaAllocator::map(Arena &arena, std::size_t size, std::size_t align) noexcept {
+    void *address = nullptr;
+
+#ifdef _MSC_VER
+    // No partial release on Windows: find an aligned hole, then map exactly there.
+    for (int attempt = 0; attempt < 8 && !address; ++attempt) {
+        void *hole = VirtualAlloc(nullptr, size + align, MEM_RESERVE, PAGE_NOACCESS);
+        if (!hole) {
+            return nullptr;
+        }
+        VirtualFree(hole, 0, MEM_RELEASE);
+        const DWORD flags = MEM_RESERVE | MEM_COMMIT | (hugePages == HugePages::Explicit && size % hugePageSize == 0 ? MEM_LARGE_PAGES : 0);
+        address = VirtualAllocExNuma(GetCurrentProcess(), reinterpret_cast<void *>(alignUp(reinterpret_cast<std::uintptr_t>(hole), align)),
+                                     size, flags, PAGE_READWRITE, arena.node);
+    }
+    return address;
+#else
+    const std::size_t total = size + (align > pageSize ? align : 0);
+    void *mapping = MAP_FAILED;
+
+    if (hugePages == HugePages::Explicit && size % hugePageSize == 0 && align % hugePageSize == 0) {
+        mapping = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        mapping = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // Trim to an aligned range of `size`.
+    const auto start = reinterpret_cast<std::uintptr_t>(mapping);
+    const std::uintptr_t aligned = alignUp(start, align);
+    if (aligned > start) {
+        munmap(mapping, aligned - start);
+    }
+    if (start + total > aligned + size) {
+        munmap(reinterpret_cast<void *>(aligned + size), start + total - aligned - size);
+    }
+    address = reinterpret_cast<void *>(aligned);
+
+    if (hugePages == HugePages::Transparent) {
+        madvise(address, size, MADV_HUGEPAGE);
+    }
+    place(arena, address, size);
+    return address;
+#endif
+}
+
+void NumaAllocator::unmap(void *address, std::size_t size) noexcept {
+#ifdef _MSC_VER
+    (void)size;
+    VirtualFree(address, 0, MEM_RELEASE);
+#else
+    munmap(address, size);
+#endif
+}
+
+void NumaAllocator::place(Arena &arena, void *address, std::size_t size) noexcept {
+    switch (placement) {
+    case NodePlacement::Local:
+        break;
+
+    case NodePlacement::Bind:
+        if (bindMemory(address, size, arena.node, true)) {
+            break;
+        }
+        [[fallthrough]];
+
+    case NodePlacement::FirstTouch: {
+        // Memory-only nodes have no CPU to touch from; the pages land wherever they are first used.
+        if (arena.cpus.empty()) {
+            break;
+        }
+
+        Thread toucher {
+            [address, size, step = pageSize]() {
+                auto *bytes = static_cast<volatile unsigned char *>(address);
+                for (std::size_t offset = 0; offset < size; offset += step) {
+                    bytes[offset] = 0;
+                }
+                return nullptr;
+            }
+        };
+        toucher.start(arena.cpus);
+        toucher.join();
+        break;
+    }
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef SYS_NUMA_ALLOCATOR_H
+#define SYS_NUMA_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CpuSet.h"
+#include "Processor.h"
+
+namespace sys {
+
+enum class HugePages : std::uint32_t {
+    None,
+    Transparent,    // madvise(MADV_HUGEPAGE) on every chunk
+    Explicit,       // MAP_HUGETLB from the reserved pool, normal pages when it runs dry
+};
+
+// How the pages of a range end up on their node.
+enum class NodePlacement : std::uint32_t {
+    Local,          // single node machine, nothing to do
+    Bind,           // mbind(MPOL_BIND)
+    FirstTouch,     // faulted in by a thread pinned to the node, when mbind is refused
+};
+
+// Binds (strict) or prefers a node for the not yet touched pages of a range, without libnuma.
+bool                bindMemory(void *address, std::size_t size, std::uint32_t node, bool strict) noexcept;
+// Node the page holding `address` is on, -1U when not faulted in or not known.
+std::uint32_t       getPageNode(const void *address) noexcept;
+
+// One arena per NUMA node. Small blocks come from size classes carved out of node bound chunks
+// and go back to per-class free lists of the node they came from; large blocks are mapped on
+// their own. Classes are multiples of the CPUID line size up to a page and of the page size above,
+// so blocks never share a line with a neighbour of a different class.
+class NumaAllocator {
+public:
+    explicit        NumaAllocator(const Processor &cpu, HugePages hugePages = HugePages::None, std::size_t chunkSize = 4 << 20) noexcept;
+                    ~NumaAllocator();
+
+                    NumaAllocator(const NumaAllocator &) = delete;
+    NumaAllocator & operator=(const NumaAllocator &) = delete;
+
+    // On the node of the calling thread's CPU.
+    void *          allocate(std::size_t size) noexcept;
+    // On `node`, nullptr when it has no arena or the memory cannot be mapped.
+    void *          allocate(std::size_t size, std::uint32_t node) noexcept;
+    // `size` as passed to allocate().
+    void            deallocate(void *block, std::size_t size) noexcept;
+
+    // Size a request is rounded up to.
+    std::size_t     getBlockSize(std::size_t size) const noexcept;
+    std::size_t     getMaxSmallSize() const noexcept { return classes.back(); }
+    std::size_t     getPageSize() const noexcept { return pageSize; }
+    std::size_t     getHugePageSize() const noexcept { return hugePageSize; }
+    NodePlacement   getPlacement() const noexcept { return placement; }
+    // Bytes mapped for a node's arena, chunks and large blocks.
+    std::size_t     getMappedBytes(std::uint32_t node) const noexcept;
+
+private:
+    struct Arena {
+        std::uint32_t           node;
+        CpuSet                  cpus;
+        std::mutex              mutex;
+        unsigned char *         cursor { nullptr };     // bump allocation in the newest chunk
+        unsigned char *         limit { nullptr };
+        std::vector<void *>     chunks;
+        std::vector<void *>     freeLists;              // per class, linked through the blocks
+        std::size_t             mapped { 0 };
+    };
+
+    // Start of every chunk, chunks are aligned to their size.
+    struct ChunkHeader {
+        std::uint32_t           node;
+    };
+
+    Arena *         find(std::uint32_t node) const noexcept { return node < byNode.size() ? byNode[node] : nullptr; }
+    std::uint32_t   getClass(std::size_t size) const noexcept;
+    void *          map(Arena &arena, std::size_t size, std::size_t align) noexcept;
+    void            unmap(void *address, std::size_t size) noexcept;
+    void            place(Arena &arena, void *address, std::size_t size) noexcept;
+
+    const Processor &       cpu;
+    HugePages               hugePages;
+    NodePlacement           placement;
+    std::size_t             lineSize;
+    std::size_t             pageSize;
+    std::size_t             hugePageSize;
+    std::size_t             chunkSize;
+    std::vector<std::size_t> classes;
+    std::vector<std::unique_ptr<Arena>> arenas;
+    std::vector<Arena *>    byNode;                     // by node id
+};
+
+}
+
+#endif // SYS_NUMA_ALLOCATOR_H
@@ -0,0 +1,156 @@
+#include "PerCpu.h"
+
+#include <cstdlib>
+#include <thread>
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "NumaAllocator.h"
+
+namespace sys {
+
+namespace {
+
+std::size_t pageSize() noexcept {
+#ifdef _MSC_VER
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+}
+
+PerCpuStorage::PerCpuStorage(const Processor &cpu, std::size_t size, std::size_t align) noexcept {
+    const std::size_t line = std::max<std::size_t>(cpu.getCacheLineSize() ? cpu.getCacheLineSize() : cacheLineAlign, align);
+    const std::size_t page = pageSize();
+    stride = (size + line - 1) / line * line;
+
+    // Group CPUs by node so each node's slots share pages that can be bound to it.
+    std::vector<std::pair<std::uint32_t, std::vector<std::uint32_t>>> groups;
+    std::uint32_t maxCpu = 0;
+    for (const LogicalCore &core: cpu.getCores()) {
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const auto &group) { return group.first == core.node; });
+        if (it == groups.end()) {
+            it = groups.insert(groups.end(), { core.node, {} });
+        }
+        it->second.push_back(core.index);
+        maxCpu = std::max(maxCpu, core.index);
+    }
+    if (groups.empty()) {
+        groups.push_back({ -1U, { 0 } });
+    }
+
+    for (const auto &group: groups) {
+        mappingSize += (group.second.size() * stride + page - 1) / page * page;
+    }
+
+#ifdef _MSC_VER
+    mapping = VirtualAlloc(nullptr, mappingSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+    }
+#endif
+    if (!mapping) {
+        // Nothing sensible to fall back to for per-CPU state.
+        std::abort();
+    }
+
+    slots.resize(maxCpu + 1);
+    nodeLocal = cpu.getNumaNodes().size() <= 1;
+
+    auto *region = static_cast<unsigned char *>(mapping);
+    bool bound = true;
+    for (const auto &group: groups) {
+        const std::size_t regionSize = (group.second.size() * stride + page - 1) / page * page;
+        if (!nodeLocal && group.first != -1U) {
+            bound = bindMemory(region, regionSize, group.first, false) && bound;
+        }
+        for (std::size_t i = 0; i < group.second.size(); ++i) {
+            slots[group.second[i]] = region + i * stride;
+        }
+        region += regionSize;
+    }
+    nodeLocal = nodeLocal || bound;
+    fallback = *std::find_if(slots.begin(), slots.end(), [](void *p) { return p != nullptr; });
+}
+
+PerCpuStorage::~PerCpuStorage() {
+#ifdef _MSC_VER
+    VirtualFree(mapping, 0, MEM_RELEASE);
+#else
+    munmap(mapping, mappingSize);
+#endif
+}
+
+std::int64_t ShardedCounter::read() const noexcept {
+    std::int64_t sum = 0;
+    shards.forEachSlot([&](const std::atomic<std::int64_t> &shard) {
+        sum += shard.load(std::memory_order_relaxed);
+    });
+    return sum;
+}
+
+TopologyRollup<std::int64_t> ShardedCounter::rollup() const noexcept {
+    return shards.rollup([](const std::atomic<std::int64_t> &shard) { return shard.load(std::memory_order_relaxed); },
+                         [](std::int64_t a, std::int64_t b) { return a + b; });
+}
+
+ShardedFreeList::Shard & ShardedFreeList::lock(Shard &shard) noexcept {
+    while (shard.busy.test_and_set(std::memory_order_acquire)) {
+        // Only contended when the holder was preempted, let it run.
+        std::this_thread::yield();
+    }
+    return shard;
+}
+
+void ShardedFreeList::push(void *block) noexcept {
+    Shard &shard = lock(shards.local());
+
+    if (shard.count == ShardCapacity) {
+        std::lock_guard guard { mutex };
+        shared.insert(shared.end(), shard.blocks + ShardCapacity / 2, shard.blocks + ShardCapacity);
+        shard.count = ShardCapacity / 2;
+    }
+    shard.blocks[shard.count++] = block;
+    unlock(shard);
+}
+
+void * ShardedFreeList::pop() noexcept {
+    Shard &shard = lock(shards.local());
+
+    if (!shard.count) {
+        std::lock_guard guard { mutex };
+        const std::size_t n = std::min<std::size_t>(shared.size(), ShardCapacity / 2);
+        std::copy(shared.end() - static_cast<std::ptrdiff_t>(n), shared.end(), shard.blocks);
+        shared.resize(shared.size() - n);
+        shard.count = static_cast<std::uint32_t>(n);
+    }
+
+    void *block = shard.count ? shard.blocks[--shard.count] : nullptr;
+    unlock(shard);
+    return block;
+}
+
+std::size_t ShardedFreeList::size() noexcept {
+    std::size_t n = 0;
+    shards.forEachSlot([&](Shard &shard) {
+        n += lock(shard).count;
+        unlock(shard);
+    });
+
+    std::lock_guard guard { mutex };
+    return n + shared.size();
+}
+
+}
@@ -0,0 +1,245 @@
+#pragma once
+#ifndef SYS_PER_CPU_H
+#define SYS_PER_CPU_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Processor.h"
+
+namespace sys {
+
+// Slot storage of PerCpu: one slot per logical CPU, `stride` bytes apart, each node's slots in a
+// region of pages bound to that node. Without a probed topology there is a single slot.
+class PerCpuStorage {
+public:
+                    PerCpuStorage(const Processor &cpu, std::size_t size, std::size_t align) noexcept;
+                    ~PerCpuStorage();
+
+                    PerCpuStorage(const PerCpuStorage &) = delete;
+    PerCpuStorage & operator=(const PerCpuStorage &) = delete;
+
+    // By OS CPU number, nullptr for CPUs that were not probed.
+    INLINE void *   get(std::uint32_t cpu) const noexcept { return cpu < slots.size() ? slots[cpu] : nullptr; }
+    std::span<void * const> getSlots() const noexcept { return slots; }
+    // Slot of the lowest probed CPU, which need not be CPU 0; never nullptr.
+    INLINE void *   getFallback() const noexcept { return fallback; }
+    std::size_t     getStride() const noexcept { return stride; }
+    bool            isNodeLocal() const noexcept { return nodeLocal; }
+
+private:
+    void *                  mapping { nullptr };
+    std::size_t             mappingSize { 0 };
+    std::size_t             stride { 0 };
+    std::vector<void *>     slots;
+    void *                  fallback { nullptr };
+    bool                    nodeLocal { false };
+};
+
+// Value at each level of the topology, every level reduced from the one below it:
+// logical CPU -> physical core -> L3 -> NUMA node -> machine.
+template <class R>
+struct TopologyRollup {
+    struct Entry {
+        std::uint32_t   id;     // LogicalCore::core, LogicalCore::l3 (an index in getCaches()), node id
+        std::uint32_t   node;
+        R               value;
+    };
+
+    std::vector<Entry>  cores;
+    std::vector<Entry>  l3;     // an L3 spanning several nodes (sub-NUMA clustering) has one entry per node
+    std::vector<Entry>  nodes;
+    R                   total {};
+};
+
+// A T for every logical CPU, each in its own cache lines (the line size CPUID reports) and, on
+// NUMA machines, in memory of the CPU's node. Threads migrate and share CPUs, so a slot is only
+// "mostly" private: T must stay correct under concurrent use, it just is rarely contended.
+template <class T>
+class PerCpu {
+public:
+    explicit        PerCpu(const Processor &cpu) noexcept;
+                    ~PerCpu();
+
+                    PerCpu(const PerCpu &) = delete;
+    PerCpu &        operator=(const PerCpu &) = delete;
+
+    // Slot of the calling thread's CPU; CPUs outside the probed set share the slot of the lowest probed CPU.
+    INLINE T &      local() noexcept { return *slot(cpu.currentCpu()); }
+    INLINE T &      operator[](std::uint32_t index) noexcept { return *slot(index); }
+
+    template <class Fn>
+    void            forEach(Fn &&fn) const noexcept;        // fn(const LogicalCore &, T &)
+    template <class Fn>
+    void            forEachSlot(Fn &&fn) const noexcept;    // fn(T &), also without a topology
+
+    // map(const T &) -> R per CPU, combined with reduce(R, R) -> R up the topology.
+    template <class Map, class Reduce>
+    auto            rollup(Map &&map, Reduce &&reduce) const noexcept;
+
+    const Processor &getProcessor() const noexcept { return cpu; }
+    bool            isNodeLocal() const noexcept { return storage.isNodeLocal(); }
+
+private:
+    INLINE T *      slot(std::uint32_t index) const noexcept {
+        void *p = storage.get(index);
+        return std::launder(static_cast<T *>(p ? p : storage.getFallback()));
+    }
+
+    const Processor &   cpu;
+    PerCpuStorage       storage;
+};
+
+template <class T>
+PerCpu<T>::PerCpu(const Processor &cpu) noexcept : cpu{ cpu }, storage{ cpu, sizeof(T), alignof(T) } {
+    for (void *p: storage.getSlots()) {
+        if (p) {
+            ::new (p) T();
+        }
+    }
+}
+
+template <class T>
+PerCpu<T>::~PerCpu() {
+    for (void *p: storage.getSlots()) {
+        if (p) {
+            std::launder(static_cast<T *>(p))->~T();
+        }
+    }
+}
+
+template <class T>
+template <class Fn>
+void PerCpu<T>::forEach(Fn &&fn) const noexcept {
+    for (const LogicalCore &core: cpu.getCores()) {
+        fn(core, *slot(core.index));
+    }
+}
+
+template <class T>
+template <class Fn>
+void PerCpu<T>::forEachSlot(Fn &&fn) const noexcept {
+    for (void *p: storage.getSlots()) {
+        if (p) {
+            fn(*std::launder(static_cast<T *>(p)));
+        }
+    }
+}
+
+template <class T>
+template <class Map, class Reduce>
+auto PerCpu<T>::rollup(Map &&map, Reduce &&reduce) const noexcept {
+    using R = std::decay_t<decltype(map(std::declval<const T &>()))>;
+    using Entry = typename TopologyRollup<R>::Entry;
+
+    TopologyRollup<R> result;
+    const auto cores = cpu.getCores();
+    if (cores.empty()) {
+        return result;
+    }
+
+    // Topology order, so every domain is one run at each level.
+    std::vector<const LogicalCore *> order(cores.size());
+    std::transform(cores.begin(), cores.end(), order.begin(), [](const LogicalCore &core) { return &core; });
+    std::sort(order.begin(), order.end(), [](const LogicalCore *a, const LogicalCore *b) {
+        if (a->node != b->node) {
+            return a->node < b->node;
+        }
+        if (a->l3 != b->l3) {
+            return a->l3 < b->l3;
+        }
+        return a->core < b->core;
+    });
+
+    // One level up: reduce runs of `below` whose parents compare equal.
+    const auto combine = [&](const std::vector<Entry> &below, std::vector<Entry> &above, auto parentOf) {
+        for (std::size_t i = 0; i < below.size(); ++i) {
+            const Entry parent = parentOf(i);
+            if (i && parentOf(i - 1).id == parent.id && parentOf(i - 1).node == parent.node) {
+                above.back().value = reduce(above.back().value, below[i].value);
+            } else {
+                above.push_back({ parent.id, parent.node, below[i].value });
+            }
+        }
+    };
+
+    std::vector<Entry> threads;
+    std::vector<const LogicalCore *> coreOf;    // representative logical CPU of each core entry
+    threads.reserve(order.size());
+    for (const LogicalCore *core: order) {
+        threads.push_back({ core->index, core->node, map(*slot(core->index)) });
+    }
+
+    combine(threads, result.cores, [&](std::size_t i) { return Entry { order[i]->core, order[i]->node, {} }; });
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (!i || order[i]->core != order[i - 1]->core || order[i]->node != order[i - 1]->node) {
+            coreOf.push_back(order[i]);
+        }
+    }
+
+    combine(result.cores, result.l3, [&](std::size_t i) { return Entry { coreOf[i]->l3, coreOf[i]->node, {} }; });
+    combine(result.l3, result.nodes, [&](std::size_t i) { return Entry { result.l3[i].node, result.l3[i].node, {} }; });
+
+    result.total = result.nodes.front().value;
+    for (std::size_t i = 1; i < result.nodes.size(); ++i) {
+        result.total = reduce(result.total, result.nodes[i].value);
+    }
+    return result;
+}
+
+// Event counter: add() is an uncontended atomic add on the caller's CPU slot, reading sums the slots.
+class ShardedCounter {
+public:
+    explicit        ShardedCounter(const Processor &cpu) noexcept : shards{ cpu } {}
+
+    INLINE void     add(std::int64_t n = 1) noexcept { shards.local().fetch_add(n, std::memory_order_relaxed); }
+    // Not a snapshot: adds racing with the read may or may not be included.
+    std::int64_t    read() const noexcept;
+    TopologyRollup<std::int64_t> rollup() const noexcept;
+
+private:
+    PerCpu<std::atomic<std::int64_t>>   shards;
+};
+
+// Free blocks cached per CPU, the way allocators keep per-CPU magazines: push and pop hit the
+// caller's CPU list, which spills half to (or refills from) a shared list when full (or empty).
+class ShardedFreeList {
+public:
+    static constexpr std::uint32_t  ShardCapacity = 62;
+
+    explicit        ShardedFreeList(const Processor &cpu) noexcept : shards{ cpu } {}
+
+    void            push(void *block) noexcept;
+    // nullptr when neither the caller's CPU list nor the shared list has a block.
+    void *          pop() noexcept;
+    // Blocks held, in the CPU lists and the shared list.
+    std::size_t     size() noexcept;
+
+private:
+    struct Shard {
+        // Taken briefly on every operation: a thread preempted mid-operation, or one that migrated
+        // after choosing the shard, may race with the CPU's current thread.
+        std::atomic_flag    busy;
+        std::uint32_t       count { 0 };
+        void *              blocks[ShardCapacity];
+    };
+
+    static Shard &  lock(Shard &shard) noexcept;
+    static void     unlock(Shard &shard) noexcept { shard.busy.clear(std::memory_order_release); }
+
+    PerCpu<Shard>           shards;
+    std::mutex              mutex;
+    std::vector<void *>     shared;
+};
+
+}
+
+#endif // SYS_PER_CPU_H
@@ -1,7 +1,12 @@
 #include "Processor.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
 
 #if defined(_MSC_VER)
 #include <immintrin.h>
@@ -10,41 +15,149 @@
 #include <cpuid.h>
 #include <pthread.h>
 #include <sched.h>
+#include <sys/mman.h>
 #endif
 
-#include "Thread.h"
+#include "Cgroup.h"
+#include "CpuSet.h"
+#include "CpuidDump.h"
+#include "Sysfs.h"
+#include "TopologyProbe.h"
 
 namespace sys {
 
-Processor::Processor() noexcept {
+Processor::Processor() noexcept : Processor(ProbeBackend::Auto) {
+}
+
+Processor::Processor(ProbeBackend backend) noexcept : Processor(backend, nullptr) {
+}
+
+Processor::Processor(ProbeBackend backend, const char *cachePath) noexcept
+    : Processor(getTopologyProbe(backend), backend == ProbeBackend::Auto, cachePath) {
+}
+
+Processor::Processor(const TopologyProbe &probe) noexcept : Processor(&probe, false, nullptr) {
+}
+
+Processor::Processor(const Processor &previous, ProbeBackend backend) noexcept
+    : Processor(getTopologyProbe(backend), backend == ProbeBackend::Auto, nullptr, &previous) {
+}
+
+Processor::Processor(const CpuidDump &dump) noexcept : Processor(&dump.getProbe(), false, nullptr, nullptr, &dump) {
+}
+
+Processor::Processor(const TopologyProbe *probe, bool fallback, const char *cachePath, const Processor *previous, const CpuidDump *dump) noexcept
+    : replay{ dump } {
     /* const unsigned long long eflags = __readeflags();
     __writeeflags(eflags | (1UL << 21UL)); */
 
-    // Get the maximum number of leaves and allocate
-    std::uint32_t maxLeaves;
-    __get_cpuid(0, &maxLeaves, &vendorId[0], &vendorId[2], &vendorId[1]);
-    leaves.resize(maxLeaves);
+    // Vendor and brand first, they are part of the topology cache key.
+    Regs regs = cpuid(0);
+    const std::uint32_t maxLeaves = regs.eax;
+    vendorId[0] = regs.ebx;
+    vendorId[1] = regs.edx;
+    vendorId[2] = regs.ecx;
+
+    regs = cpuid(0x80000000);
+
+    if (regs.eax >= 0x80000004) {
+        for (std::uint32_t i = 0; i < 3; ++i) {
+            const Regs part = cpuid(0x80000002 + i);
+            std::memcpy(&brand[i * 4], &part, sizeof(part));
+        }
+    }
+
+    if (cachePath && probe && loadCache(cachePath)) {
+        return;
+    }
+
+    // Allocate and run CPUID for all leaves, subleaf 0 where a leaf has several
+    leafData.resize(maxLeaves + 1);
 
-    // Run CPUID for all leaves
     std::uint32_t i = 0;
-    for (auto & [ eax, ebx, ecx, edx ]: leaves) {
-        __get_cpuid(i, &eax, &ebx, &ecx, &edx);
-        ++i;
+    for (auto &leaf: leafData) {
+        leaf = cpuid(i++);
     }
+    leaves = leafData;
 
-    Regs regs;
-    __get_cpuid(0x80000000, &regs.eax, &regs.ebx, &regs.ecx, &regs.edx);
+    // Same for the extended range, indexed from 0x80000000
+    if (regs.eax >= 0x80000000 && regs.eax < 0x80000100) {
+        extLeafData.resize(regs.eax - 0x80000000 + 1);
 
-    if (regs.eax > 0x80000004) {
-        __get_cpuid(0x80000002, &brand[0], &brand[1], &brand[2], &brand[3]);
-        __get_cpuid(0x80000003, &brand[4], &brand[5], &brand[6], &brand[7]);
-        __get_cpuid(0x80000004, &brand[8], &brand[9], &brand[10], &brand[11]);
+        i = 0x80000000;
+        for (auto &leaf: extLeafData) {
+            leaf = cpuid(i++);
+        }
+        extLeaves = extLeafData;
     }
 
-    detectTopology();
+    readFeatures();
+
+    // Whether the OS saves the AVX/AVX-512 register state, without it those units are unusable.
+    if (replay) {
+        xcr0 = replay->getXcr0();
+    } else if (hasOSXSAVE()) {
+#ifdef _MSC_VER
+        xcr0 = _xgetbv(0);
+#else
+        std::uint32_t lo, hi;
+        __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = (static_cast<std::uint64_t>(hi) << 32) | lo;
+#endif
+    }
+
+    if (probe) {
+        detectTopology(probe, fallback, previous);
+
+        if (cachePath) {
+            saveCache(cachePath);
+        }
+    }
+    buildCoreLookup();
 }
 
 Processor::~Processor() {
+#ifndef _MSC_VER
+    if (cacheMapping) {
+        munmap(cacheMapping, cacheMappingSize);
+    }
+#endif
+}
+
+void Processor::readFeatures() noexcept {
+    const auto leaf = [this](std::uint32_t index) noexcept {
+        return index < leaves.size() ? leaves[index] : Regs {};
+    };
+    const auto extLeaf = [this](std::uint32_t index) noexcept {
+        return index < extLeaves.size() ? extLeaves[index] : Regs {};
+    };
+    const auto subleaf = [this](std::uint32_t index, std::uint32_t sub) noexcept {
+        return index < leaves.size() ? cpuid(index, sub) : Regs {};
+    };
+
+    auto &w = features.words;
+    w[Leaf1Ecx]   = leaf(1).ecx;
+    w[Leaf1Edx]   = leaf(1).edx;
+    w[Leaf6Eax]   = leaf(6).eax;
+    w[Leaf7Ebx]   = leaf(7).ebx;
+    w[Leaf7Ecx]   = leaf(7).ecx;
+    w[Leaf7Edx]   = leaf(7).edx;
+    w[Leaf14Ebx]  = leaf(0x14).ebx;
+    w[Leaf14Ecx]  = leaf(0x14).ecx;
+    w[Ext1Ecx]    = extLeaf(1).ecx;
+    w[Ext1Edx]    = extLeaf(1).edx;
+    w[Ext7Edx]    = extLeaf(7).edx;
+    w[Ext8Ebx]    = extLeaf(8).ebx;
+
+    // Leaf 7 eax is the highest subleaf, 0xD.1 always exists with XSAVE.
+    if (leaf(7).eax >= 1) {
+        const Regs regs = subleaf(7, 1);
+        w[Leaf7S1Eax] = regs.eax;
+        w[Leaf7S1Edx] = regs.edx;
+    }
+    if (features.test(Feature::XSAVE)) {
+        w[LeafDS1Eax] = subleaf(0xD, 1).eax;
+    }
 }
 
 /*struct Thread {
@@ -71,83 +184,634 @@ static void *threadRoutine(void *arg) {
 }
 */
 
-void Processor::detectTopology() noexcept {
+void Processor::detectTopology(const TopologyProbe *probe, bool fallback, const Processor *previous) noexcept {
     /* Regs leaf;
     __get_cpuid_count(0xB, 1, &leaf.eax, &leaf.ebx, &leaf.ecx, &leaf.edx); */
 
-    const std::uint32_t numCores = getNumCores();
-    logicalCores.resize(numCores, { .x2apic = -1U });
+    // A replayed machine is every CPU of the dump, not this process's affinity.
+    const CpuSet affinity = replay ? replay->getCpus() : CpuSet::fromAffinity();
+    const std::vector<std::uint32_t> cpus(affinity.begin(), affinity.end());
 
-    std::vector<Thread> threads(numCores);
+    coreData.resize(cpus.size(), { .x2apic = -1U });
+    logicalCores = coreData;
 
-    std::uint32_t i = 0;
-    for (auto& th : threads) {
-        th = {
-            [&, i]() {
-                Regs regs;
-                __get_cpuid_count(0xB, 0, &regs.eax, &regs.ebx, &regs.ecx, &regs.edx);
-   
-                const std::uint32_t bitShift = regs.eax & 0x0000000F;
-                const std::uint32_t x2apic = regs.edx;
+    // Deterministic cache parameters: Intel leaf 4, AMD 0x8000001D (needs TopologyExtensions). Same layout.
+    std::uint32_t cacheLeaf = 0;
+    if (isIntel() && leaves.size() > 4) {
+        cacheLeaf = 4;
+    } else if (isAMD() && extLeaves.size() > 0x1D && has(Feature::TOPOEXT)) {
+        cacheLeaf = 0x8000001D;
+    }
 
-                logicalCores[i].index = i;
-                logicalCores[i].x2apic = x2apic;
-                logicalCores[i].core = x2apic >> bitShift;
+    // V2 extended topology (0x1F) adds module, tile and die levels to 0xB.
+    std::uint32_t topologyLeaf = 0;
+    if (leaves.size() > 0x1F && leaves[0x1F].ebx) {
+        topologyLeaf = 0x1F;
+    } else if (leaves.size() > 0xB && leaves[0xB].ebx) {
+        topologyLeaf = 0xB;
+    }
 
-                __get_cpuid_count(0x1A, 0, &regs.eax, &regs.ebx, &regs.ecx, &regs.edx);
+    // Zen core complexes (CCX) and dies (CCD), which 0xB and 0x1F do not enumerate.
+    const bool complexes = isAMD() && has(Feature::TOPOEXT) && extLeaves.size() > 0x1E;
+
+    std::vector<std::vector<Cache>> perCore(cpus.size());
+
+    // CPUs a previous snapshot already decoded keep their core and cache descriptors, the rest
+    // are probed; `slots` maps a probed CPU back to its place in coreData.
+    std::vector<std::uint32_t> probed, slots;
+    for (std::uint32_t i = 0; i < cpus.size(); ++i) {
+        const LogicalCore *known = previous ? previous->getCoreByCpu(cpus[i]) : nullptr;
+        if (!known) {
+            probed.push_back(cpus[i]);
+            slots.push_back(i);
+            continue;
+        }
+
+        coreData[i] = *known;
+        coreData[i].l1i = coreData[i].l1d = coreData[i].l2 = coreData[i].l3 = -1U;
+        for (const Cache &cache: previous->getCaches()) {
+            if (cache.cpus.test(cpus[i])) {
+                Cache &desc = perCore[i].emplace_back(cache);
+                desc.parent = -1U;
+                desc.cpus = { cpus[i] };
+            }
+        }
+    }
+
+    ProbeFunc decode {
+        [&, this](std::uint32_t slot, std::uint32_t cpu, const CpuidReader &cpuid) {
+            const std::uint32_t i = slots[slot];
+            Regs regs {};
 
-                logicalCores[i].coreType = (regs.eax & 0xff000000) >> 24; // 32 = E-core (Gracemont), 64 = P-core (Golden Cove)
+            coreData[i].index = cpu;
+            decodeTopology(cpuid, topologyLeaf, coreData[i]);
+            if (complexes) {
+                decodeComplexes(cpuid, topologyLeaf, coreData[i]);
+            }
+            const std::uint32_t x2apic = coreData[i].x2apic;
+
+            regs = {};
+            if (leaves.size() > 0x1A) {
+                cpuid.read(0x1A, 0, regs);
+            }
 
-                return nullptr;
+            coreData[i].coreType = (regs.eax & 0xff000000) >> 24; // 32 = E-core (Gracemont), 64 = P-core (Golden Cove)
+
+            // Read per CPU rather than once: P- and E-cores of hybrid parts report different caches.
+            for (std::uint32_t sub = 0; cacheLeaf && sub < 16; ++sub) {
+                if (!cpuid.read(cacheLeaf, sub, regs)) {
+                    break;
+                }
+
+                const auto type = static_cast<CacheType>(regs.eax & 0x1F);
+                if (type == CacheType::Null || type > CacheType::Unified) {
+                    break;
+                }
+
+                const std::uint32_t sharing = ((regs.eax & 0x03FFC000) >> 14) + 1;
+
+                Cache cache;
+                cache.level      = (regs.eax & 0xE0) >> 5;
+                cache.type       = type;
+                cache.ways       = ((regs.ebx & 0xFFC00000) >> 22) + 1;
+                cache.partitions = ((regs.ebx & 0x003FF000) >> 12) + 1;
+                cache.lineSize   = (regs.ebx & 0x00000FFF) + 1;
+                cache.sets       = regs.ecx + 1;
+                cache.size       = cache.ways * cache.partitions * cache.lineSize * cache.sets;
+                // Masked, not shifted: on hybrid parts a shifted id of a 2-way shared P-core L2 can
+                // equal that of an 8-way shared E-core cluster L2.
+                cache.id         = x2apic & ~((1U << std::bit_width(sharing - 1)) - 1);
+                cache.cpus.set(cpu);
+
+                perCore[i].push_back(std::move(cache));
             }
-        };
-        th.start(1ULL << i);
-        ++i;
+        }
+    };
+
+    if (!probed.empty() && !probe->run(probed, decode) && fallback) {
+        // The preferred backend can fail part way (e.g. a CPU went offline), redo it the old way.
+        probe = getTopologyProbe(ProbeBackend::Threads);
+        probe->run(probed, decode);
     }
 
-    for (auto &th : threads) {
-        th.join();
+    probeName = probe->name();
+
+    // CPUs the probe never reached (thread failed to start, CPU went offline) keep x2apic -1U
+    // and are dropped rather than left as bogus entries.
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < coreData.size(); ++i) {
+        if (coreData[i].x2apic != -1U) {
+            // A self move-assignment would empty the vector.
+            if (kept != i) {
+                coreData[kept] = coreData[i];
+                perCore[kept] = std::move(perCore[i]);
+            }
+            ++kept;
+        }
     }
+    coreData.resize(kept);
+    perCore.resize(kept);
+    logicalCores = coreData;
+
+    buildCaches(perCore);
+    checkPackages();
+    detectNuma();
+    classifyCores();
+}
 
-#if 0
+void Processor::classifyCores() noexcept {
+    for (const auto &core: logicalCores) {
+        allCpus.set(core.index);
+        classCpus[static_cast<std::uint32_t>(getCoreClass(core))].set(core.index);
+    }
+}
 
-    cpu_set_t *cpusetp = CPU_ALLOC(numCores);
-    std::size_t s = CPU_ALLOC_SIZE(numCores);
+void Processor::buildCoreLookup() noexcept {
+    coreByCpu.clear();
+    coreByApic.clear();
+    for (const auto &core: logicalCores) {
+        if (core.x2apic == -1U) {
+            continue;
+        }
+        coreByCpu.resize(std::max(coreByCpu.size(), static_cast<std::size_t>(core.index) + 1));
+        coreByCpu[core.index] = &core;
+        coreByApic.resize(std::max(coreByApic.size(), static_cast<std::size_t>(core.x2apic) + 1));
+        coreByApic[core.x2apic] = &core;
+    }
 
-    std::uint32_t i = 0;
-    for (auto &th: threads) {
-        CPU_ZERO_S(s, cpusetp);
-        CPU_SET_S(i, s, cpusetp);
+#ifndef _MSC_VER
+    // Nothing to check for a replayed machine, and its features may not exist here.
+    if (replay) {
+        return;
+    }
 
-        pthread_attr_init(&th.attr);
-        pthread_attr_setaffinity_np(&th.attr, s, cpusetp);
-        pthread_create(&th.th, &th.attr, threadRoutine, &logicalCores[i]);
+    // TSC_AUX is only as good as the kernel (or hypervisor) keeps it, so check it against
+    // sched_getcpu(). One agreeing read out of a few is enough, the others may have migrated.
+    const auto agrees = [this](CpuIdSource source) noexcept {
+        cpuIdSource = source;
+        for (int i = 0; i < 4; ++i) {
+            if (currentCpu() == static_cast<std::uint32_t>(sched_getcpu())) {
+                return true;
+            }
+        }
+        return false;
+    };
 
-        ++i;
+    if (!(has<Feature::RDPID>() && agrees(CpuIdSource::Rdpid)) && !(has<Feature::RDTSCP>() && agrees(CpuIdSource::Rdtscp))) {
+        cpuIdSource = CpuIdSource::Getcpu;
     }
+#endif
+}
 
-    for (auto &th: threads) {
-        pthread_join(th.th, nullptr);
-        pthread_attr_destroy(&th.attr);
+const CpuSet & Processor::getAffinity(WorkClass workClass) const noexcept {
+    switch (workClass) {
+    case WorkClass::LatencyCritical:
+        return getCoreClassCpus(CoreClass::Performance).empty() ? allCpus : getCoreClassCpus(CoreClass::Performance);
+    case WorkClass::Background:
+        return getCoreClassCpus(CoreClass::Efficiency).empty() ? allCpus : getCoreClassCpus(CoreClass::Efficiency);
+    case WorkClass::Default:
+        break;
     }
+    return allCpus;
+}
 
-#endif
+void Processor::decodeTopology(const CpuidReader &cpuid, std::uint32_t leaf, LogicalCore &core) noexcept {
+    enum : std::uint32_t { Invalid, SMT, Core, Module, Tile, Die, DieGroup, NumLevels };
 
-    for (const auto &core: logicalCores) {
-        std::printf("core x2apic: 0x%x\ncore: %d\n", core.x2apic, core.core);
+    Regs regs {};
+
+    if (!leaf) {
+        // Pre-0xB parts: the 8 bit initial APIC id, one thread per core.
+        cpuid.read(1, 0, regs);
+        core.x2apic = regs.ebx >> 24;
+        core.core = core.x2apic;
+        return;
+    }
+
+    // shifts[level]: right shift of the x2APIC id that yields the id of the domain above that level.
+    std::uint32_t shifts[NumLevels] {};
+    bool enumerated[NumLevels] {};
+
+    for (std::uint32_t sub = 0; sub < 16 && cpuid.read(leaf, sub, regs); ++sub) {
+        const std::uint32_t type = (regs.ecx & 0xFF00) >> 8;
+        if (type == Invalid) {
+            break;
+        }
+
+        core.x2apic = regs.edx;
+        if (type < NumLevels) {
+            shifts[type] = regs.eax & 0x1F;
+            enumerated[type] = true;
+        }
+    }
+
+    // A level that is not enumerated spans the same CPUs as the one below it, so its id is the
+    // id of the level above (Linux does the same).
+    for (std::uint32_t level = Core; level < NumLevels; ++level) {
+        if (!enumerated[level]) {
+            shifts[level] = shifts[level - 1];
+        }
+    }
+
+    const std::uint32_t x2apic = core.x2apic;
+
+    core.smt    = x2apic & ((1U << shifts[SMT]) - 1);
+    core.core   = x2apic >> shifts[SMT];
+    core.module = x2apic >> shifts[Core];
+    core.tile   = x2apic >> shifts[Module];
+    core.die    = x2apic >> shifts[Tile];
+    core.chip   = x2apic >> shifts[DieGroup];
+}
+
+void Processor::decodeComplexes(const CpuidReader &cpuid, std::uint32_t leaf, LogicalCore &core) const noexcept {
+    enum : std::uint32_t { Invalid, Core, Complex, Die, Socket, NumLevels };
+
+    Regs regs {};
+
+    // Zen and Zen+ have no leaf 0xB; 0x8000001E still has the threads per core.
+    if (!leaf && cpuid.read(0x8000001E, 0, regs)) {
+        const std::uint32_t smtBits = std::bit_width((regs.ebx & 0xFF00) >> 8);
+        core.smt  = core.x2apic & ((1U << smtBits) - 1);
+        core.core = core.x2apic >> smtBits;
+    }
+
+    // Zen 4 on: 0x80000026 enumerates core, complex, die and socket levels the way 0x1F does.
+    if (extLeaves.size() > 0x26) {
+        std::uint32_t shifts[NumLevels] {};
+        bool enumerated[NumLevels] {};
+
+        for (std::uint32_t sub = 0; sub < 8 && cpuid.read(0x80000026, sub, regs); ++sub) {
+            const std::uint32_t type = (regs.ecx & 0xFF00) >> 8;
+            if (type == Invalid) {
+                break;
+            }
+            if (type < NumLevels) {
+                shifts[type] = regs.eax & 0x1F;
+                enumerated[type] = true;
+            }
+        }
+
+        if (enumerated[Complex] && enumerated[Die]) {
+            core.ccx = core.x2apic & ~((1U << shifts[Complex]) - 1);
+            core.ccd = core.die = core.x2apic >> shifts[Die];
+            return;
+        }
+    }
+
+    // Before that the complex is the L3 domain of 0x8000001D.
+    std::uint32_t sharing = 0;
+    for (std::uint32_t sub = 0; sub < 16 && cpuid.read(0x8000001D, sub, regs) && (regs.eax & 0x1F); ++sub) {
+        if (((regs.eax & 0xE0) >> 5) == 3) {
+            sharing = ((regs.eax & 0x03FFC000) >> 14) + 1;
+        }
+    }
+    if (!sharing) {
+        return;
+    }
+    const std::uint32_t shift = std::bit_width(sharing - 1);
+    const std::uint32_t complex = core.x2apic >> shift;
+    core.ccx = core.x2apic & ~((1U << shift) - 1);
+
+    // Dies by generation. Every Zen part reports base family 0xF.
+    const std::uint32_t family = getFamilyId() + getExtendedFamilyId();
+    const std::uint32_t model = (getExtendedModelId() << 4) | getModel();
+
+    if (family == 0x17 && model < 0x30) {
+        // Zen, Zen+: two complexes per die, and the die is the node 0x8000001E reports.
+        cpuid.read(0x8000001E, 0, regs);
+        core.ccd = regs.ecx & 0xFF;
+    } else if (family == 0x17) {
+        // Zen 2: two complexes per CCD, numbered consecutively.
+        core.ccd = complex >> 1;
+    } else {
+        // Zen 3: one complex per CCD.
+        core.ccd = complex;
+    }
+    core.die = core.ccd;
+}
+
+void Processor::checkPackages() noexcept {
+    // CPUID package ids are only trusted if they group CPUs exactly like the kernel does;
+    // hypervisors are known to hand out inconsistent APIC ids.
+    std::vector<std::uint32_t> packages(coreData.size());
+    char path[96];
+    char buf[32];
+
+    for (std::size_t i = 0; i < coreData.size(); ++i) {
+        char *end;
+        std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", coreData[i].index);
+        if (!readFile(path, buf, sizeof(buf))) {
+            return;
+        }
+        packages[i] = static_cast<std::uint32_t>(std::strtoul(buf, &end, 0));
+        if (end == buf) {
+            return;
+        }
+    }
+
+    // Same grouping means a one-to-one map between the two kinds of ids.
+    std::map<std::uint32_t, std::uint32_t> packageOfChip, chipOfPackage;
+    for (std::size_t i = 0; i < coreData.size(); ++i) {
+        if (packageOfChip.try_emplace(coreData[i].chip, packages[i]).first->second != packages[i] ||
+            chipOfPackage.try_emplace(packages[i], coreData[i].chip).first->second != coreData[i].chip) {
+            for (std::size_t k = 0; k < coreData.size(); ++k) {
+                coreData[k].chip = packages[k];
+            }
+            return;
+        }
     }
 }
 
+void Processor::readNodeMemory(NumaNode &node) const noexcept {
+    char path[96];
+    char buf[4096];
+
+    // Lines look like "Node 0 MemTotal:       12345 kB".
+    std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/meminfo", node.id);
+    if (readFile(path, buf, sizeof(buf))) {
+        if (const char *p = std::strstr(buf, "MemTotal:")) {
+            node.memTotal = std::strtoull(p + 9, nullptr, 10) * 1024;
+        }
+        if (const char *p = std::strstr(buf, "MemFree:")) {
+            node.memFree = std::strtoull(p + 8, nullptr, 10) * 1024;
+        }
+    }
+}
+
+void Processor::detectNuma() noexcept {
+    // The online node list uses the cpulist format, so a CpuSet doubles as a node set.
+    CpuSet online;
+    char path[96];
+    char buf[4096];
+
+    if (readFile("/sys/devices/system/node/online", buf, sizeof(buf))) {
+        online = CpuSet::fromList(buf);
+        for (const std::uint32_t id: online) {
+            NumaNode node { .id = id };
+
+            std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", id);
+            if (readFile(path, buf, sizeof(buf))) {
+                node.cpus = CpuSet::fromList(buf);
+            }
+
+            readNodeMemory(node);
+
+            // One distance per online node, in node order.
+            std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/distance", id);
+            if (readFile(path, buf, sizeof(buf))) {
+                char *p = buf;
+                char *end;
+                for (auto d = std::strtoul(p, &end, 10); end != p; d = std::strtoul(p, &end, 10)) {
+                    node.distances.push_back(static_cast<std::uint32_t>(d));
+                    p = end;
+                }
+            }
+
+            numaNodes.push_back(std::move(node));
+        }
+    }
+
+    if (numaNodes.empty()) {
+        // No NUMA information: everything is one local node.
+        NumaNode node { .id = 0, .distances = { 10 } };
+        for (const auto &core: coreData) {
+            node.cpus.set(core.index);
+        }
+        numaNodes.push_back(std::move(node));
+    }
+
+    for (auto &core: coreData) {
+        core.node = numaNodes.front().id;
+        for (const auto &node: numaNodes) {
+            if (node.cpus.test(core.index)) {
+                core.node = node.id;
+                break;
+            }
+        }
+    }
+}
+
+const NumaNode * Processor::getNumaNode(std::uint32_t id) const noexcept {
+    for (const auto &node: numaNodes) {
+        if (node.id == id) {
+            return &node;
+        }
+    }
+    return nullptr;
+}
+
+std::uint64_t Processor::getCrystalFrequency() const noexcept {
+    if (leaves.size() <= 0x15 || !leaves[0x15].eax || !leaves[0x15].ebx) {
+        return 0;
+    }
+    if (leaves[0x15].ecx) {
+        return leaves[0x15].ecx;
+    }
+    if (!isIntel() || getFamilyId() != 6) {
+        return 0;
+    }
+
+    // Parts that report the ratio but not the crystal, from the SDM's leaf 0x15 table.
+    switch ((getExtendedModelId() << 4) | getModel()) {
+    case 0x4E: case 0x5E: case 0x8E: case 0x9E:     // Skylake, Kaby Lake client
+    case 0xA5: case 0xA6:                           // Comet Lake
+        return 24000000;
+    case 0x55:                                      // Skylake, Cascade Lake server
+        return 25000000;
+    case 0x5C:                                      // Goldmont
+        return 19200000;
+    default:
+        return 0;
+    }
+}
+
+std::uint64_t Processor::getTscFrequency() const noexcept {
+    if (const std::uint64_t crystal = getCrystalFrequency()) {
+        return crystal * leaves[0x15].ebx / leaves[0x15].eax;
+    }
+
+    // Leaf 1 ecx bit 31: running under a hypervisor, which may report TSC kHz in 0x40000010 eax.
+    if (leaves.size() > 1 && (leaves[1].ecx & (1U << 31))) {
+        const Regs regs = cpuid(0x40000000);
+        if (regs.eax >= 0x40000010 && regs.eax < 0x40000100) {
+            return static_cast<std::uint64_t>(cpuid(0x40000010).eax) * 1000;
+        }
+    }
+    return 0;
+}
+
+std::uint64_t Processor::getBaseFrequency() const noexcept {
+    return leaves.size() > 0x16 ? static_cast<std::uint64_t>(leaves[0x16].eax & 0xFFFF) * 1000000 : 0;
+}
+
+std::uint32_t Processor::getNumaDistance(std::uint32_t from, std::uint32_t to) const noexcept {
+    const NumaNode *node = getNumaNode(from);
+    const NumaNode *target = getNumaNode(to);
+    if (!node || !target) {
+        return -1U;
+    }
+
+    const auto column = static_cast<std::size_t>(target - numaNodes.data());
+    return column < node->distances.size() ? node->distances[column] : -1U;
+}
+
+void Processor::buildCaches(std::span<const std::vector<Cache>> perCore) noexcept {
+    std::vector<std::vector<std::uint32_t>> instances(perCore.size());
+    std::map<std::tuple<std::uint32_t, CacheType, std::uint32_t>, std::uint32_t> known;   // (level, type, id) -> index
+
+    // Merge the per CPU descriptors into shared instances.
+    for (std::size_t i = 0; i < perCore.size(); ++i) {
+        for (const Cache &desc: perCore[i]) {
+            const auto [it, added] = known.try_emplace({ desc.level, desc.type, desc.id }, static_cast<std::uint32_t>(caches.size()));
+            const std::uint32_t index = it->second;
+
+            if (added) {
+                caches.push_back(desc);
+            } else {
+                caches[index].cpus |= desc.cpus;
+            }
+
+            instances[i].push_back(index);
+
+            LogicalCore &core = coreData[i];
+            switch (desc.level) {
+            case 1: (desc.type == CacheType::Instruction ? core.l1i : core.l1d) = index; break;
+            case 2: core.l2 = index; break;
+            case 3: core.l3 = index; break;
+            }
+        }
+    }
+
+    // Link each instance to the next level that backs it, which makes the list a tree rooted at the LLCs.
+    for (const auto &indices: instances) {
+        for (const std::uint32_t child: indices) {
+            for (const std::uint32_t parent: indices) {
+                if (caches[parent].level == caches[child].level + 1 && caches[parent].type != CacheType::Instruction) {
+                    caches[child].parent = parent;
+                }
+            }
+        }
+    }
+}
+
+const Cache * Processor::getLastLevelCache(const LogicalCore &core) const noexcept {
+    std::uint32_t index = core.l1d;
+    if (index == -1U) {
+        return nullptr;
+    }
+
+    while (caches[index].parent != -1U) {
+        index = caches[index].parent;
+    }
+
+    return &caches[index];
+}
+
 std::uint32_t Processor::getNumCores() const noexcept {
-#ifdef _MSC_VER
-    SYSTEM_INFO systemInfo;
-    GetSystemInfo(&systemInfo);
-    return systemInfo.dwNumberOfProcessors;
-#else
-    cpu_set_t setp;
-    sched_getaffinity(0, sizeof(cpu_set_t), &setp);
-    return static_cast<std::uint32_t>(CPU_COUNT(&setp));
-#endif
+    return replay ? replay->getCpus().count() : CpuSet::fromAffinity().count();
+}
+
+Regs Processor::cpuid(std::uint32_t leaf, std::uint32_t subleaf) const noexcept {
+    Regs regs {};
+    (replay ? *replay->getReader(replay->getCpus().first()) : getNativeCpuidReader()).read(leaf, subleaf, regs);
+    return regs;
+}
+
+bool Processor::readFile(const char *path, char *buf, std::size_t size) const noexcept {
+    return replay ? replay->readFile(path, buf, size) : sysfs::readString(path, buf, size);
+}
+
+std::uint32_t Processor::getParallelism() const noexcept {
+    // The dump has no cgroup; the capturing process could use all of its CPUs.
+    return replay ? replay->getCpus().count() : getCpuBudget().parallelism;
+}
+
+std::uint64_t Processor::getGroupId(const LogicalCore &core, Proximity level) const noexcept {
+    const std::uint64_t chip = static_cast<std::uint64_t>(core.chip) << 32;
+
+    switch (level) {
+    case Proximity::Self:
+        return core.index;
+    case Proximity::SMT:
+        return chip | core.core;
+    case Proximity::L2:
+        return core.l2 != -1U ? core.l2 : getGroupId(core, Proximity::SMT);
+    case Proximity::L3:
+        if (core.ccx != -1U) {
+            return chip | core.ccx;
+        }
+        return core.l3 != -1U ? core.l3 : getGroupId(core, Proximity::Die);
+    case Proximity::Die:
+        return chip | core.die;
+    case Proximity::Node:
+        return core.node;
+    case Proximity::Package:
+        return core.chip;
+    case Proximity::Remote:
+        break;
+    }
+    return 0;
 }
 
-}
\ No newline at end of file
+std::vector<CpuSet> Processor::getCpuGroups(Proximity level) const noexcept {
+    std::vector<CpuSet> groups;
+    std::map<std::uint64_t, std::size_t> indices;
+
+    for (const auto &core: logicalCores) {
+        const auto [it, added] = indices.try_emplace(getGroupId(core, level), groups.size());
+        if (added) {
+            groups.emplace_back();
+        }
+        groups[it->second].set(core.index);
+    }
+    return groups;
+}
+
+CpuSet Processor::getCpuGroup(const LogicalCore &core, Proximity level) const noexcept {
+    const std::uint64_t id = getGroupId(core, level);
+
+    CpuSet group;
+    for (const auto &other: logicalCores) {
+        if (getGroupId(other, level) == id) {
+            group.set(other.index);
+        }
+    }
+    return group;
+}
+
+Proximity getProximity(const LogicalCore &a, const LogicalCore &b) noexcept {
+    if (a.index == b.index) {
+        return Proximity::Self;
+    }
+    if (a.chip == b.chip && a.core == b.core) {
+        return Proximity::SMT;
+    }
+    if (a.l2 != -1U && a.l2 == b.l2) {
+        return Proximity::L2;
+    }
+
+    // Sub-NUMA clustering splits a die, and its L3, into nodes; CPUs on different nodes of one
+    // die are only Package. On parts whose L3 spans several dies the die is the tighter domain.
+    const bool sameDie = a.chip == b.chip && a.die == b.die && a.node == b.node;
+
+    if (sameDie && a.l3 != -1U && a.l3 == b.l3) {
+        return Proximity::L3;
+    }
+    if (sameDie) {
+        return Proximity::Die;
+    }
+    if (a.node == b.node) {
+        return Proximity::Node;
+    }
+    if (a.chip == b.chip) {
+        return Proximity::Package;
+    }
+    return Proximity::Remote;
+}
+
+const char * getProximityName(Proximity proximity) noexcept {
+    static const char *names[] = { "self", "smt", "l2", "l3", "die", "node", "package", "remote" };
+    return names[static_cast<std::uint32_t>(proximity)];
+}
+
+}
@@ -14,6 +14,8 @@
 #include <vector>
 #include <bit>
 
+#include "CpuSet.h"
+#include "Features.h"
 
 #define BIT_CHECK(val, bits) \
     (((val) & (bits)) == (bits))
@@ -81,24 +83,143 @@ inline To bit_cast(const From &from) noexcept {
 
 namespace sys {
 
+class CpuidDump;
+struct CpuidReader;
+class TopologyProbe;
+
+// Compile-time padding for data written by different threads. Processor::getCacheLineSize() has the real value.
+inline constexpr std::size_t cacheLineAlign = 64;
+
 struct Regs {
     std::uint32_t   eax, ebx, ecx, edx;
 };
 
+enum class ProbeBackend : std::uint32_t {
+    Auto,       // Cheapest backend available on this machine.
+    Threads,    // One pinned thread per CPU.
+    Migrate,    // One thread migrating itself with sched_setaffinity.
+    Sysfs,      // sysfs topology plus /dev/cpu/N/cpuid, no threads.
+    None,       // Feature leaves only, getCores() stays empty.
+};
+
+enum class CacheType : std::uint32_t {
+    Null,
+    Data,
+    Instruction,
+    Unified,
+};
+
+// One physical cache instance and the logical CPUs that share it.
+struct Cache {
+    std::uint32_t   level;
+    CacheType       type;
+    std::uint32_t   size;           // bytes
+    std::uint32_t   ways;
+    std::uint32_t   lineSize;
+    std::uint32_t   partitions;
+    std::uint32_t   sets;
+    std::uint32_t   id;             // x2apic with the bits of the sharing logical processor count cleared
+    std::uint32_t   parent { -1U }; // index of the next level cache holding this one's lines, -1U for the LLC
+    CpuSet          cpus;
+};
+
+struct NumaNode {
+    std::uint32_t   id;
+    CpuSet          cpus;
+    std::uint64_t   memTotal;   // bytes
+    std::uint64_t   memFree;    // bytes, at construction
+    std::vector<std::uint32_t> distances; // SLIT distance to each of getNumaNodes(), 10 = local
+};
+
+// Ids at each CPUID topology level. smt is the thread number inside its core; the others
+// are x2APIC derived and unique across the machine, so equal ids mean the same domain.
+// Levels a part does not report span the same CPUs as the level above them.
 struct LogicalCore {
     std::uint32_t   index;
     std::uint32_t   x2apic;
-    std::uint32_t   chip;
+    std::uint32_t   chip;       // package (socket)
+    std::uint32_t   node;       // NUMA node id
+    std::uint32_t   smt;
     std::uint32_t   core;
+    std::uint32_t   module;
+    std::uint32_t   tile;
+    std::uint32_t   die;        // on AMD the CCD
     std::uint32_t   coreType;
+    // AMD core complex (CCX, the CPUs behind one L3; its lowest x2APIC id) and complex die (CCD),
+    // -1U on other parts.
+    std::uint32_t   ccx { -1U };
+    std::uint32_t   ccd { -1U };
+
+    // Indices into Processor::getCaches(), -1U when the level does not exist.
+    std::uint32_t   l1i { -1U };
+    std::uint32_t   l1d { -1U };
+    std::uint32_t   l2 { -1U };
+    std::uint32_t   l3 { -1U };
 };
 
+// Hybrid parts: leaf 0x1A core type 0x20 is an Atom (E) core, 0x40 a Core (P) core.
+// Everything on a non-hybrid part is Performance.
+enum class CoreClass : std::uint32_t {
+    Performance,
+    Efficiency,
+};
+
+// Where Processor::currentCpu() gets the CPU number from, fastest first. rdpid and rdtscp read
+// IA32_TSC_AUX, which the kernel loads with (node << 12) | cpu.
+enum class CpuIdSource : std::uint32_t {
+    Rdpid,
+    Rdtscp,
+    Getcpu,     // sched_getcpu(): rseq or the vDSO
+};
+
+// What a thread or task is for, which decides the cores it should run on.
+enum class WorkClass : std::uint32_t {
+    Default,            // anywhere
+    LatencyCritical,    // P-cores only
+    Background,         // E-cores when there are any
+};
+
+// How close two logical CPUs are, nearest first.
+enum class Proximity : std::uint32_t {
+    Self,
+    SMT,        // same physical core
+    L2,         // share an L2
+    L3,         // share an L3 on the same die
+    Die,        // same die
+    Node,       // same NUMA node
+    Package,    // same package, different node (sub-NUMA clustering)
+    Remote,
+};
+
+inline constexpr std::uint32_t numProximityLevels = static_cast<std::uint32_t>(Proximity::Remote) + 1;
+
+Proximity           getProximity(const LogicalCore &a, const LogicalCore &b) noexcept;
+const char *        getProximityName(Proximity proximity) noexcept;
+
 class Processor {
 public:
                     Processor() noexcept;
+    explicit        Processor(ProbeBackend backend) noexcept;
+    // Uses the topology cache file at cachePath when it was written on this machine in the same
+    // state (vendor, brand, microcode, online and affinity masks), otherwise probes and rewrites it.
+                    Processor(ProbeBackend backend, const char *cachePath) noexcept;
+    // Probes with a caller supplied backend, e.g. an ExecutorProbe over long-lived per-CPU threads.
+    explicit        Processor(const TopologyProbe &probe) noexcept;
+    // Refresh after CPUs came, went or the affinity changed: CPUs `previous` already knows keep
+    // their decoded topology and caches, only the others are probed.
+                    Processor(const Processor &previous, ProbeBackend backend) noexcept;
+    // The machine a CPUID dump was captured on (CpuidDump.h), decoded here; the dump must outlive it.
+    explicit        Processor(const CpuidDump &dump) noexcept;
                     ~Processor();
 
+                    Processor(const Processor &) = delete;
+    Processor &     operator=(const Processor &) = delete;
+
+    // Logical CPUs in the affinity mask. In a container that can be far more than the cgroup lets
+    // the process use; getParallelism() also applies the cpuset and CFS quota (Cgroup.h). Replayed,
+    // both are the CPUs of the dump.
     std::uint32_t   getNumCores() const noexcept;
+    std::uint32_t   getParallelism() const noexcept;
 
     const char *    getVendorId() const noexcept;
     const char *    getBrandId() const noexcept;
@@ -113,19 +234,47 @@ public:
     std::uint32_t   getExtendedFamilyId() const noexcept;
     std::uint32_t   getExtendedModelId() const noexcept;
 
+    // Baseline features of the build fold to true, everything else is one bit test. That is only
+    // right for the machine running the build: ask a replayed Processor getFeatures().test().
+    INLINE bool     has(Feature feature) const noexcept { return isBaselineFeature(feature) || features.test(feature); }
+    template <Feature F>
+    INLINE bool     has() const noexcept {
+        if constexpr (isBaselineFeature(F)) {
+            return true;
+        } else {
+            return features.test(F);
+        }
+    }
+    const Features &getFeatures() const noexcept { return features; }
+
     // ecx:
-    INLINE bool     hasSSE3() const noexcept { return BIT_CHECK(leaves[1].ecx, bit_SSE3); }
-    INLINE bool     hasSSSE3() const noexcept { return BIT_CHECK(leaves[1].ecx, bit_SSSE3); }
-    INLINE bool     hasSSE41() const noexcept { return BIT_CHECK(leaves[1].ecx, bit_SSE4_1); }
-    INLINE bool     hasSSE42() const noexcept { return BIT_CHECK(leaves[1].ecx, bit_SSE4_2); }
-    INLINE bool     hasAVX() const noexcept { return BIT_CHECK(leaves[1].ecx, bit_AVX); }
+    INLINE bool     hasSSE3() const noexcept { return has<Feature::SSE3>(); }
+    INLINE bool     hasSSSE3() const noexcept { return has<Feature::SSSE3>(); }
+    INLINE bool     hasSSE41() const noexcept { return has<Feature::SSE41>(); }
+    INLINE bool     hasSSE42() const noexcept { return has<Feature::SSE42>(); }
+    INLINE bool     hasAVX() const noexcept { return has<Feature::AVX>(); }
+    INLINE bool     hasPOPCNT() const noexcept { return has<Feature::POPCNT>(); }
+    INLINE bool     hasOSXSAVE() const noexcept { return has<Feature::OSXSAVE>(); }
 
     // edx:
-    INLINE bool     hasHTT() const noexcept { return BIT_CHECK(leaves[1].edx, bit_HTT); }
-    INLINE bool     hasMMX() const noexcept { return BIT_CHECK(leaves[1].edx, bit_MMX); }
-    INLINE bool     hasSSE() const noexcept { return BIT_CHECK(leaves[1].edx, bit_SSE); }
-    INLINE bool     hasSSE2() const noexcept { return BIT_CHECK(leaves[1].edx, bit_SSE2); }
-    INLINE bool     hasHYBRID() const noexcept { return BIT_CHECK(leaves[7].edx, bit_HYBRID); }
+    INLINE bool     hasHTT() const noexcept { return has<Feature::HTT>(); }
+    INLINE bool     hasMMX() const noexcept { return has<Feature::MMX>(); }
+    INLINE bool     hasSSE() const noexcept { return has<Feature::SSE>(); }
+    INLINE bool     hasSSE2() const noexcept { return has<Feature::SSE2>(); }
+    INLINE bool     hasHYBRID() const noexcept { return has<Feature::HYBRID>(); }
+
+    // leaf 7 ebx:
+    INLINE bool     hasBMI1() const noexcept { return has<Feature::BMI1>(); }
+    INLINE bool     hasBMI2() const noexcept { return has<Feature::BMI2>(); }
+    INLINE bool     hasAVX2() const noexcept { return has<Feature::AVX2>(); }
+    INLINE bool     hasAVX512F() const noexcept { return has<Feature::AVX512F>(); }
+    INLINE bool     hasAVX512DQ() const noexcept { return has<Feature::AVX512DQ>(); }
+    INLINE bool     hasAVX512BW() const noexcept { return has<Feature::AVX512BW>(); }
+    INLINE bool     hasAVX512VL() const noexcept { return has<Feature::AVX512VL>(); }
+
+    // XCR0: the OS saves YMM (bits 1-2) and ZMM/opmask (bits 5-7) state on context switch.
+    INLINE bool     isAVXEnabled() const noexcept { return (xcr0 & 0x06) == 0x06; }
+    INLINE bool     isAVX512Enabled() const noexcept { return (xcr0 & 0xE6) == 0xE6; }
 
     template <class Func>
     INLINE void forEachThread(Func &&f) const noexcept {
@@ -134,16 +283,101 @@ public:
         }
     }
 
-    std::span<const LogicalCore> getCores() const noexcept { return logicalCores; }    
+    std::span<const LogicalCore> getCores() const noexcept { return logicalCores; }
+
+    // OS number of the CPU the caller runs on; the thread may migrate right after.
+    INLINE std::uint32_t currentCpu() const noexcept;
+    // LogicalCore of currentCpu(), nullptr when that CPU was not probed.
+    INLINE const LogicalCore *currentCore() const noexcept { return getCoreByCpu(currentCpu()); }
+    INLINE const LogicalCore *getCoreByCpu(std::uint32_t cpu) const noexcept { return cpu < coreByCpu.size() ? coreByCpu[cpu] : nullptr; }
+    const LogicalCore *getCoreByApicId(std::uint32_t x2apic) const noexcept { return x2apic < coreByApic.size() ? coreByApic[x2apic] : nullptr; }
+    CpuIdSource     getCpuIdSource() const noexcept { return cpuIdSource; }
+    std::span<const Cache> getCaches() const noexcept { return caches; }
+    std::span<const NumaNode> getNumaNodes() const noexcept { return numaNodes; }
+
+    const NumaNode *getNumaNode(std::uint32_t id) const noexcept;
+    // SLIT distance between two node ids; 10 is local, -1U for unknown nodes.
+    std::uint32_t   getNumaDistance(std::uint32_t from, std::uint32_t to) const noexcept;
+
+    // CPUs grouped at a proximity level, in order of their lowest CPU: Proximity::SMT gives the
+    // physical cores, L3 the core complexes (CCX) on AMD and the L3 domains elsewhere, Die the
+    // CCDs or dies. Keeping a thread group inside one of getCpuGroups(Proximity::L3) keeps its
+    // cache-to-cache traffic off the die interconnect.
+    std::vector<CpuSet> getCpuGroups(Proximity level) const noexcept;
+    // The group of `core` at that level, e.g. the CPUs sharing its CCX.
+    CpuSet          getCpuGroup(const LogicalCore &core, Proximity level) const noexcept;
+
+    // Largest (outermost) cache the core sees, nullptr when no cache leaf is available.
+    const Cache *   getLastLevelCache(const LogicalCore &core) const noexcept;
+    // CLFLUSH line size from leaf 1, the granularity to pad shared data to.
+    std::uint32_t   getCacheLineSize() const noexcept;
+
+    // Leaf 0x80000007: the TSC ticks at a constant rate through P-, C- and T-state changes.
+    INLINE bool     hasInvariantTsc() const noexcept { return has<Feature::INVARIANT_TSC>(); }
+    // Hz from leaf 0x15, or the hypervisor timing leaf 0x40000010 in a guest; 0 when CPUID does not say.
+    std::uint64_t   getTscFrequency() const noexcept;
+    // Hz of the crystal the TSC is derived from, leaf 0x15 or the known crystal of the model.
+    std::uint64_t   getCrystalFrequency() const noexcept;
+    // Leaf 0x16 base (nominal) frequency in Hz, 0 when not reported.
+    std::uint64_t   getBaseFrequency() const noexcept;
+
+    const char *    getProbeName() const noexcept { return probeName; }
+    bool            isReplay() const noexcept { return replay != nullptr; }
+    // True when the tables are read in place from a mapped topology cache.
+    bool            isCached() const noexcept { return cacheMapping != nullptr; }
+    // Topology cache image (TopologyCache.h) of this processor.
+    void            serialize(std::vector<unsigned char> &image) const noexcept;
+
+    CoreClass       getCoreClass(const LogicalCore &core) const noexcept;
+    const CpuSet &  getCoreClassCpus(CoreClass coreClass) const noexcept;
+    // Affinity for a thread doing this kind of work, e.g. th.start(cpu.getAffinity(WorkClass::LatencyCritical)).
+    const CpuSet &  getAffinity(WorkClass workClass) const noexcept;
 
 private:
-    void              detectTopology() noexcept;
+                      Processor(const TopologyProbe *probe, bool fallback, const char *cachePath, const Processor *previous = nullptr, const CpuidDump *dump = nullptr) noexcept;
+
+    void              detectTopology(const TopologyProbe *probe, bool fallback, const Processor *previous) noexcept;
+    static void       decodeTopology(const CpuidReader &cpuid, std::uint32_t leaf, LogicalCore &core) noexcept;
+    void              decodeComplexes(const CpuidReader &cpuid, std::uint32_t leaf, LogicalCore &core) const noexcept;
+    void              buildCaches(std::span<const std::vector<Cache>> perCore) noexcept;
+    void              detectNuma() noexcept;
+    void              readNodeMemory(NumaNode &node) const noexcept;
+    void              checkPackages() noexcept;
+    void              classifyCores() noexcept;
+    void              buildCoreLookup() noexcept;
+    std::uint64_t     getGroupId(const LogicalCore &core, Proximity level) const noexcept;
+    void              readFeatures() noexcept;
+    bool              loadCache(const char *path) noexcept;
+    void              saveCache(const char *path) const noexcept;
+    // CPUID and sysfs of this machine, or of the replayed one.
+    Regs              cpuid(std::uint32_t leaf, std::uint32_t subleaf = 0) const noexcept;
+    bool              readFile(const char *path, char *buf, std::size_t size) const noexcept;
 
     std::uint32_t     vendorId[4] {};
-    std::vector<Regs> leaves;
-    std::uint32_t     brand[12];
-
-    std::vector<LogicalCore> logicalCores;
+    // Views of the tables below, or of the mapped topology cache.
+    std::span<const Regs> leaves;
+    std::span<const Regs> extLeaves;
+    std::span<const LogicalCore> logicalCores;
+
+    std::vector<Regs> leafData;
+    std::vector<Regs> extLeafData;
+    std::vector<LogicalCore> coreData;
+    std::uint32_t     brand[12] {};
+    std::uint64_t     xcr0 {};
+    Features          features;
+
+    std::vector<Cache> caches;
+    std::vector<NumaNode> numaNodes;
+    CpuSet            allCpus;
+    CpuSet            classCpus[2];
+    const char *      probeName { "" };
+    // Flat tables by OS CPU number and by x2APIC id, nullptr for holes.
+    std::vector<const LogicalCore *> coreByCpu;
+    std::vector<const LogicalCore *> coreByApic;
+    CpuIdSource       cpuIdSource { CpuIdSource::Getcpu };
+    void *            cacheMapping { nullptr };
+    std::size_t       cacheMappingSize { 0 };
+    const CpuidDump * replay { nullptr };
 };
 
 INLINE const char * Processor::getVendorId() const noexcept {
@@ -162,6 +396,40 @@ INLINE bool Processor::isAMD() const noexcept {
     return vendorId[0] == signature_AMD_ebx && vendorId[2] == signature_AMD_ecx && vendorId[1] == signature_AMD_edx;
 }
 
+INLINE std::uint32_t Processor::getCacheLineSize() const noexcept {
+    return ((leaves[1].ebx & 0x0000FF00) >> 8) * 8;
+}
+
+INLINE std::uint32_t Processor::currentCpu() const noexcept {
+#ifdef _MSC_VER
+    return GetCurrentProcessorNumber();
+#else
+    switch (cpuIdSource) {
+    case CpuIdSource::Rdpid: {
+        std::uint64_t aux;
+        __asm__ volatile ("rdpid %0" : "=r"(aux));
+        return static_cast<std::uint32_t>(aux) & 0xFFF;
+    }
+    case CpuIdSource::Rdtscp: {
+        std::uint32_t aux;
+        __asm__ volatile ("rdtscp" : "=c"(aux) : : "eax", "edx");
+        return aux & 0xFFF;
+    }
+    case CpuIdSource::Getcpu:
+        break;
+    }
+    return static_cast<std::uint32_t>(sched_getcpu());
+#endif
+}
+
+INLINE CoreClass Processor::getCoreClass(const LogicalCore &core) const noexcept {
+    return core.coreType == 0x20 ? CoreClass::Efficiency : CoreClass::Performance;
+}
+
+INLINE const CpuSet & Processor::getCoreClassCpus(CoreClass coreClass) const noexcept {
+    return classCpus[static_cast<std::uint32_t>(coreClass)];
+}
+
 INLINE std::uint32_t Processor::getType() const noexcept {
     return (leaves[1].eax & 0x00003000) >> 12;
 }
@@ -179,7 +447,7 @@ INLINE std::uint32_t Processor::getStepping() const noexcept {
 }
 
 INLINE std::uint32_t Processor::getExtendedFamilyId() const noexcept {
-    return (leaves[1].eax & 0x0FF00000) >> 24;
+    return (leaves[1].eax & 0x0FF00000) >> 20;
 }
 
 INLINE std::uint32_t Processor::getExtendedModelId() const noexcept {
@@ -0,0 +1,242 @@
+#include "SharedTopology.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sys {
+
+static constexpr std::uint64_t sharedTopologyMagic = 0x4D48535953595300ULL; // "\0SYSSHM"
+// A publish copies at most a few MiB; a sequence odd for longer than this belongs to a publisher
+// that stalled or died mid-publish.
+static constexpr std::chrono::milliseconds publishTimeout { 20 };
+
+static std::size_t getSegmentSize(std::uint32_t capacity) noexcept {
+    return sizeof(SharedTopologyHeader) + 2 * static_cast<std::size_t>(capacity);
+}
+
+static unsigned char * getBuffer(const SharedTopologyHeader *header, std::uint32_t index) noexcept {
+    return const_cast<unsigned char *>(reinterpret_cast<const unsigned char *>(header + 1)) + index * static_cast<std::size_t>(header->capacity);
+}
+
+TopologyPublisher::~TopologyPublisher() {
+#ifndef _MSC_VER
+    if (header) {
+        munmap(header, mappingSize);
+    }
+#endif
+}
+
+bool TopologyPublisher::open(const char *segment, std::uint32_t capacity) noexcept {
+#ifdef _MSC_VER
+    return false;
+#else
+    if (header || std::snprintf(name, sizeof(name), "%s", segment) >= static_cast<int>(sizeof(name))) {
+        return false;
+    }
+
+    capacity = (capacity + cacheLineAlign - 1) & ~static_cast<std::uint32_t>(cacheLineAlign - 1);
+    const std::size_t size = getSegmentSize(capacity);
+
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+
+    // A segment left by an earlier publisher is reused when it has the same shape, so clients that
+    // still have it mapped see the next publish. Anything else is replaced; its readers keep the
+    // old mapping until they reopen.
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) != size)) {
+        close(fd);
+        shm_unlink(name);
+        fd = -1;
+    }
+
+    bool reuse = fd >= 0;
+    if (!reuse) {
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+    }
+
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    header = static_cast<SharedTopologyHeader *>(base);
+    mappingSize = size;
+
+    if (reuse && (header->magic != sharedTopologyMagic || header->capacity != capacity)) {
+        reuse = false;
+    }
+    if (!reuse) {
+        std::memset(base, 0, sizeof(SharedTopologyHeader));
+        header->capacity = capacity;
+        header->magic = sharedTopologyMagic;
+    }
+    return true;
+#endif
+}
+
+bool TopologyPublisher::publish(const Processor &cpu) noexcept {
+    if (!header) {
+        return false;
+    }
+
+    cpu.serialize(image);
+    if (image.size() > header->capacity) {
+        return false;
+    }
+
+    // A publisher that died mid-write leaves the sequence odd; continue from the next even value.
+    std::uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+    sequence += sequence & 1;
+
+    const std::uint32_t next = header->active.load(std::memory_order_relaxed) ^ 1;
+
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(getBuffer(header, next), image.data(), image.size());
+    header->sizes[next].store(static_cast<std::uint32_t>(image.size()), std::memory_order_relaxed);
+    header->active.store(next, std::memory_order_relaxed);
+
+    header->sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
+
+void TopologyPublisher::unlink() noexcept {
+#ifndef _MSC_VER
+    if (name[0]) {
+        shm_unlink(name);
+    }
+#endif
+}
+
+SharedTopology::~SharedTopology() {
+#ifndef _MSC_VER
+    if (header) {
+        munmap(const_cast<SharedTopologyHeader *>(header), mappingSize);
+    }
+#endif
+}
+
+bool SharedTopology::open(const char *segment) noexcept {
+#ifdef _MSC_VER
+    return false;
+#else
+    if (header) {
+        return false;
+    }
+
+    const int fd = shm_open(segment, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(SharedTopologyHeader)) {
+        base = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const auto *h = static_cast<const SharedTopologyHeader *>(base);
+    if (h->magic != sharedTopologyMagic || getSegmentSize(h->capacity) > static_cast<std::size_t>(st.st_size)) {
+        munmap(base, static_cast<std::size_t>(st.st_size));
+        return false;
+    }
+
+    header = h;
+    mappingSize = static_cast<std::size_t>(st.st_size);
+    parsed = 1;
+    stale = false;
+    view = {};
+    view.header = &empty;
+    return true;
+#endif
+}
+
+std::uint32_t SharedTopology::acquire() noexcept {
+    std::chrono::steady_clock::time_point deadline {};
+
+    for (std::uint32_t spins = 0;; ++spins) {
+        const std::uint32_t sequence = header->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            if (spins < 64) {
+                continue;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (deadline == std::chrono::steady_clock::time_point {}) {
+                deadline = now + publishTimeout;
+            }
+            if (now < deadline) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Give up on the publish. It writes the buffer the current view does not use, so the
+            // view survives if this is the first publish after it; otherwise fall back to empty.
+            if (sequence != parsed + 1) {
+                view = {};
+                view.header = &empty;
+                parsed = 1;
+            }
+            stale = true;
+            return parsed;
+        }
+        stale = false;
+        if (sequence == parsed) {
+            return sequence;
+        }
+
+        // Only pointer arithmetic and bounds checks, the tables themselves stay in the segment.
+        const std::uint32_t active = header->active.load(std::memory_order_relaxed) & 1;
+        const std::uint32_t size = header->sizes[active].load(std::memory_order_relaxed);
+
+        TopologyCacheView next;
+        const bool ok = size <= header->capacity && next.parse(getBuffer(header, active), size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+
+        view = ok ? next : TopologyCacheView {};
+        if (!ok) {
+            view.header = &empty;
+        }
+        parsed = sequence;
+        return sequence;
+    }
+}
+
+bool SharedTopology::validate(std::uint32_t version) const noexcept {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+    if (!stale) {
+        return sequence == version;
+    }
+
+    // The empty view has no buffer to lose. Otherwise a publish that completed and started over
+    // may have rewritten the buffer fn() was reading.
+    return (version & 1) || sequence == version + 1;
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef SYS_SHARED_TOPOLOGY_H
+#define SYS_SHARED_TOPOLOGY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "Features.h"
+#include "Processor.h"
+#include "TopologyCache.h"
+
+namespace sys {
+
+// POSIX shared memory segment `cpuid --publish` keeps up to date.
+inline constexpr const char *defaultTopologySegment = "/sys-topology";
+
+// Segment layout: this header, then two buffers of `capacity` bytes holding topology cache images
+// (TopologyCache.h). A publish writes the inactive buffer and flips `active` inside the seqlock, so
+// a reader's views stay intact across one republish and a reader further behind sees the
+// sequence change.
+struct alignas(cacheLineAlign) SharedTopologyHeader {
+    std::uint64_t               magic;
+    std::uint32_t               capacity;
+    std::atomic<std::uint32_t>  sequence;   // odd while a publish is in progress
+    std::atomic<std::uint32_t>  active;
+    std::atomic<std::uint32_t>  sizes[2];
+};
+
+// Writer side, one per segment.
+class TopologyPublisher {
+public:
+                    TopologyPublisher() noexcept = default;
+                    ~TopologyPublisher();
+
+                    TopologyPublisher(const TopologyPublisher &) = delete;
+    TopologyPublisher & operator=(const TopologyPublisher &) = delete;
+
+    // Creates (or takes over) the segment, sized for images up to `capacity` bytes.
+    bool            open(const char *name = defaultTopologySegment, std::uint32_t capacity = 1 << 20) noexcept;
+    // False when the image does not fit the segment.
+    bool            publish(const Processor &cpu) noexcept;
+    // Removes the name; mapped readers keep their mapping.
+    void            unlink() noexcept;
+
+private:
+    SharedTopologyHeader *      header { nullptr };
+    std::size_t                 mappingSize { 0 };
+    char                        name[256] {};
+    std::vector<unsigned char>  image;
+};
+
+// Reader side. After open() every query is a plain memory read; the snapshot is empty until the
+// first publish. Views are only guaranteed consistent between acquire() and a successful validate().
+//
+//     const auto version = topology.acquire();
+//     ... getCores(), has(), ...
+//     if (!topology.validate(version)) retry
+//
+// or topology.read([](const SharedTopology &t) { ... }), which retries for you and accepts a
+// stale snapshot rather than wait on a publisher that stopped mid-publish.
+class SharedTopology {
+public:
+                    SharedTopology() noexcept = default;
+                    ~SharedTopology();
+
+                    SharedTopology(const SharedTopology &) = delete;
+    SharedTopology &operator=(const SharedTopology &) = delete;
+
+    bool            open(const char *name = defaultTopologySegment) noexcept;
+    bool            isOpen() const noexcept { return header != nullptr; }
+
+    // Starts a read of the current snapshot and returns its version; waits out a publish in progress.
+    // When the publish does not finish within a bound, returns the last good snapshot, or an empty
+    // one, with isStale() set.
+    std::uint32_t   acquire() noexcept;
+    // True when nothing was republished since acquire() returned this version. For a stale view:
+    // while the publish that timed out is still the one in progress, which does not touch its buffer.
+    bool            validate(std::uint32_t version) const noexcept;
+    bool            isStale() const noexcept { return stale; }
+
+    template <class Fn>
+    auto            read(Fn &&fn) noexcept;
+
+    std::span<const LogicalCore>        getCores() const noexcept { return view.cores; }
+    std::span<const TopologyCacheEntry> getCaches() const noexcept { return view.caches; }
+    std::span<const TopologyCacheNode>  getNumaNodes() const noexcept { return view.nodes; }
+    const Features &                    getFeatures() const noexcept { return view.header->features; }
+
+    INLINE bool     has(Feature feature) const noexcept { return isBaselineFeature(feature) || view.header->features.test(feature); }
+    CoreClass       getCoreClass(const LogicalCore &core) const noexcept { return core.coreType == 0x20 ? CoreClass::Efficiency : CoreClass::Performance; }
+    const char *    getProbeName() const noexcept { return view.header->probeName; }
+
+private:
+    const SharedTopologyHeader *header { nullptr };
+    std::size_t                 mappingSize { 0 };
+    std::uint32_t               parsed { 1 };   // sequence the view belongs to, odd = none
+    bool                        stale { false };
+    TopologyCacheView           view;
+    TopologyCacheHeader         empty {};
+};
+
+template <class Fn>
+auto SharedTopology::read(Fn &&fn) noexcept {
+    for (;;) {
+        const std::uint32_t version = acquire();
+        if constexpr (std::is_void_v<decltype(fn(*this))>) {
+            fn(static_cast<const SharedTopology &>(*this));
+            if (validate(version)) {
+                return;
+            }
+        } else {
+            auto result = fn(static_cast<const SharedTopology &>(*this));
+            if (validate(version)) {
+                return result;
+            }
+        }
+    }
+}
+
+}
+
+#endif // SYS_SHARED_TOPOLOGY_H
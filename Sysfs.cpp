@@ -0,0 +1,61 @@
+#include "Sysfs.h"
+
+#include <cstdlib>
+
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace sys::sysfs {
+
+bool readString(const char *path, char *buf, std::size_t size) noexcept {
+#ifdef _MSC_VER
+    return false;
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::size_t len = 0;
+    while (len + 1 < size) {
+        const ssize_t n = read(fd, buf + len, size - len - 1);
+        if (n <= 0) {
+            break;
+        }
+        len += static_cast<std::size_t>(n);
+    }
+    close(fd);
+
+    while (len && (buf[len - 1] == '\n' || buf[len - 1] == ' ')) {
+        --len;
+    }
+    buf[len] = '\0';
+
+    return true;
+#endif
+}
+
+bool readUInt(const char *path, std::uint64_t &value) noexcept {
+    char buf[32];
+    if (!readString(path, buf, sizeof(buf))) {
+        return false;
+    }
+
+    char *end;
+    value = std::strtoull(buf, &end, 0);
+    return end != buf;
+}
+
+bool readCpuList(const char *path, CpuSet &set) noexcept {
+    char buf[4096];
+    if (!readString(path, buf, sizeof(buf))) {
+        return false;
+    }
+
+    set = CpuSet::fromList(buf);
+    return true;
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#ifndef SYS_SYSFS_H
+#define SYS_SYSFS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CpuSet.h"
+
+namespace sys::sysfs {
+
+// Small pseudo-file readers. All return false when the file is missing or unreadable
+// (no sysfs on this platform, CPU offline, insufficient permission).
+
+// Whole file into buf, NUL terminated, trailing newline stripped.
+bool    readString(const char *path, char *buf, std::size_t size) noexcept;
+bool    readUInt(const char *path, std::uint64_t &value) noexcept;
+// Kernel cpulist format, e.g. "0-3,8,10-11".
+bool    readCpuList(const char *path, CpuSet &set) noexcept;
+
+}
+
+#endif // SYS_SYSFS_H
@@ -0,0 +1,112 @@
+// getCpuBudget() against fake cgroupfs trees: v1, v2, nested quotas, a group path from outside
+// the cgroup namespace, and no cgroup at all. Exits non-zero if any case mismatches.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "Cgroup.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+struct Expected {
+    const char *    cpus;
+    double          quota;
+    double          budget;
+    std::uint32_t   parallelism;
+    std::uint32_t   cgroupVersion;
+};
+
+void write(const fs::path &path, const char *content) {
+    fs::create_directories(path.parent_path());
+    std::ofstream { path } << content << '\n';
+}
+
+void check(const char *name, const fs::path &root, const sys::CpuSet &affinity, const Expected &expected) {
+    const sys::CpuBudget budget = sys::getCpuBudget(affinity, (root / "cgroup").string().c_str(), (root / "self").string().c_str());
+    const sys::CpuSet cpus = sys::CpuSet::fromList(expected.cpus);
+
+    const bool ok = budget.cpus.count() == cpus.count() && (budget.cpus & cpus).count() == cpus.count() &&
+        std::abs(budget.quota - expected.quota) < 1e-9 && std::abs(budget.budget - expected.budget) < 1e-9 &&
+        budget.parallelism == expected.parallelism && budget.cgroupVersion == expected.cgroupVersion;
+
+    std::printf("%-14s %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok) {
+        std::printf("    got %u cpus, quota %.3f, budget %.3f, parallelism %u, v%u; expected %s, %.3f, %.3f, %u, v%u\n",
+            budget.cpus.count(), budget.quota, budget.budget, budget.parallelism, budget.cgroupVersion,
+            expected.cpus, expected.quota, expected.budget, expected.parallelism, expected.cgroupVersion);
+        ++failures;
+    }
+}
+
+}
+
+int main() {
+    const fs::path base = fs::temp_directory_path() /
+        ("cgroup_test." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    const sys::CpuSet affinity = sys::CpuSet::range(0, 8);
+
+    {
+        // v1: co-mounted cpu,cpuacct with a 1.5 CPU quota, cpuset limited to 4 CPUs.
+        const fs::path root = base / "v1";
+        write(root / "self", "4:cpu,cpuacct:/docker/abc\n3:cpuset:/docker/abc");
+        write(root / "cgroup/cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "150000");
+        write(root / "cgroup/cpu,cpuacct/docker/abc/cpu.cfs_period_us", "100000");
+        write(root / "cgroup/cpuset/docker/abc/cpuset.effective_cpus", "0-3");
+        check("v1", root, affinity, { "0-3", 1.5, 1.5, 1, 1 });
+    }
+    {
+        // v2: the cpuset of the own group, the quota of the parent, "max" in between.
+        const fs::path root = base / "v2";
+        write(root / "self", "0::/app/svc");
+        write(root / "cgroup/cgroup.controllers", "cpuset cpu io memory");
+        write(root / "cgroup/app/cpu.max", "200000 100000");
+        write(root / "cgroup/app/svc/cpu.max", "max 100000");
+        write(root / "cgroup/app/svc/cpuset.cpus.effective", "2-5");
+        check("v2", root, affinity, { "2-5", 2, 2, 2, 2 });
+    }
+    {
+        // Nested quotas: the smallest on the path to the root wins, in both versions.
+        const fs::path v1 = base / "nested-v1";
+        write(v1 / "self", "5:cpu:/a/b");
+        write(v1 / "cgroup/cpu/a/cpu.cfs_quota_us", "50000");
+        write(v1 / "cgroup/cpu/a/cpu.cfs_period_us", "100000");
+        write(v1 / "cgroup/cpu/a/b/cpu.cfs_quota_us", "300000");
+        write(v1 / "cgroup/cpu/a/b/cpu.cfs_period_us", "100000");
+        check("nested-v1", v1, affinity, { "0-7", 0.5, 0.5, 1, 1 });
+
+        const fs::path v2 = base / "nested-v2";
+        write(v2 / "self", "0::/a/b");
+        write(v2 / "cgroup/cgroup.controllers", "cpu");
+        write(v2 / "cgroup/a/cpu.max", "300000 100000");
+        write(v2 / "cgroup/a/b/cpu.max", "250000 100000");
+        check("nested-v2", v2, affinity, { "0-7", 2.5, 2.5, 2, 2 });
+    }
+    {
+        // No cgroup namespace: the host path does not exist in the container's mount, which is
+        // the group itself.
+        const fs::path root = base / "no-namespace";
+        write(root / "self", "0::/kubepods/pod1/ctr");
+        write(root / "cgroup/cgroup.controllers", "cpuset cpu");
+        write(root / "cgroup/cpu.max", "300000 100000");
+        write(root / "cgroup/cpuset.cpus.effective", "0-5");
+        check("no-namespace", root, affinity, { "0-5", 3, 3, 3, 2 });
+    }
+    {
+        // No cgroup at all: the affinity mask is the budget.
+        const fs::path root = base / "no-cgroup";
+        fs::create_directories(root);
+        check("no-cgroup", root, affinity, { "0-7", 0, 8, 8, 0 });
+    }
+
+    std::error_code error;
+    fs::remove_all(base, error);
+    return failures ? 1 : 0;
+}
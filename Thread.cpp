@@ -4,24 +4,8 @@
 #include <pthread.h>
 #endif
 
-#ifdef __has_builtin
-#define HAS_BUILTIN(x) __has_builtin(x)
-#else
-#define HAS_BUILTIN(x) 0
-#endif
-
-#ifndef __has_builtin
-#define __has_builtin(x) 0
-#endif
-
 namespace sys {
 
-static int countTrailingZeroes(unsigned int v) noexcept {
-#if __has_builtin(__builtin_ctz)
-    return __builtin_ctz(v);
-#endif
-}
-
 Thread::~Thread() {
     if (handle) {
         join();
@@ -47,7 +31,7 @@ THREAD_ROUTINE_CALL Thread::threadRoutine(void* args) {
     return 0;
 }
 
-bool Thread::start(std::uint64_t affinityMask) noexcept {
+bool Thread::start(const CpuSet &affinity) noexcept {
 #ifdef _MSC_VER
     handle = (HANDLE) _beginthreadex(nullptr, 0, threadRoutine, this, CREATE_SUSPENDED, nullptr);
 
@@ -55,7 +39,8 @@ bool Thread::start(std::uint64_t affinityMask) noexcept {
         return false;
     }
 
-    SetThreadAffinityMask(handle, affinityMask);
+    // Only the first processor group is addressable through a plain affinity mask.
+    SetThreadAffinityMask(handle, affinity.words()[0]);
     ResumeThread(handle);
 
     return !!handle;
@@ -63,25 +48,29 @@ bool Thread::start(std::uint64_t affinityMask) noexcept {
     pthread_attr_t attr;
     pthread_attr_init(&attr);
 
-    cpu_set_t set;
-    CPU_ZERO(&set);
-
-    while (affinityMask) {
-        const auto i = countTrailingZeroes(affinityMask);
-        CPU_SET(i, &set);
-        affinityMask ^= (1ULL << i);
+    if (!affinity.empty()) {
+        pthread_attr_setaffinity_np(&attr, affinity.byteSize(), affinity.data());
     }
-    
-    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &set);
 
     const int status = pthread_create(&handle, &attr, threadRoutine, this);
 
     pthread_attr_destroy(&attr);
+    if (status != 0) {
+        handle = {};    // undefined after a failed create, and join() must not touch it
+    }
 
     return status == 0;
 #endif
 }
 
+bool Thread::setAffinity(const CpuSet &affinity) noexcept {
+#ifdef _MSC_VER
+    return SetThreadAffinityMask(handle, affinity.words()[0]) != 0;
+#else
+    return handle && pthread_setaffinity_np(handle, affinity.byteSize(), affinity.data()) == 0;
+#endif
+}
+
 bool Thread::join() noexcept {
 #ifdef _MSC_VER
     return WaitForSingleObject(handle, INFINITE) != WAIT_OBJECT_0;
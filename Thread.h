@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <memory>
 
+#include "CpuSet.h"
+
 #ifdef _MSC_VER
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -76,12 +78,12 @@ using NativeHandle = pthread_t;
 	Thread&		operator=(const Thread&) noexcept = delete;
 	Thread&		operator=(Thread&& other) noexcept;
 
-	bool		start(std::uint64_t mask) noexcept;
+	bool		start(const CpuSet &affinity) noexcept;
 	bool		join() noexcept;
 	bool		detatch() noexcept;
 	void		destroy() noexcept;
 
-	void		setAffinity(std::uint64_t affinityMask) noexcept;
+	bool		setAffinity(const CpuSet &affinity) noexcept;
 
 	static THREAD_ROUTINE_CALL threadRoutine(void *args);
 
@@ -0,0 +1,288 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <thread>
+#include <tuple>
+
+#include "AffinityPlanner.h"
+#include "Cgroup.h"
+
+namespace sys {
+
+static thread_local const ThreadPool *  currentPool = nullptr;
+static thread_local std::uint32_t       currentIndex = -1U;
+
+// The CPUs the cgroup lets us use, and no more of them than its CPU quota keeps busy: one per
+// physical core first, so a quota of 4 gets 4 cores rather than 2 cores' SMT pairs.
+static CpuSet defaultCpus(const Processor &cpu) noexcept {
+    const CpuBudget budget = getCpuBudget();
+
+    CpuSet cpus;
+    std::uint32_t count = 0;
+    for (const CpuSet &slot: planAffinity(cpu, static_cast<std::uint32_t>(cpu.getCores().size()), Placement::OnePerCore)) {
+        const std::uint32_t index = slot.first();
+        if (count < budget.parallelism && budget.cpus.test(index) && !cpus.test(index)) {
+            cpus.set(index);
+            ++count;
+        }
+    }
+    return cpus;
+}
+
+ThreadPool::ThreadPool(const Processor &cpu, StealOrder order) noexcept
+    : ThreadPool(cpu, defaultCpus(cpu), order) {
+}
+
+ThreadPool::ThreadPool(const Processor &cpu, const CpuSet &cpus, StealOrder order) noexcept : order{ order } {
+    for (const auto &core: cpu.getCores()) {
+        if (cpus.test(core.index)) {
+            auto &w = workers.emplace_back(std::make_unique<Worker>());
+            w->core = core;
+            w->coreClass = cpu.getCoreClass(core);
+            w->rng = 0x9E3779B97F4A7C15ULL * (core.index + 1);
+        }
+    }
+
+    // An offline or disallowed CPU gets no worker: nothing would pop its deque or run the tasks
+    // it is given. The others wait for ready, their index and victims depend on who is left.
+    for (auto &w: workers) {
+        Worker &self = *w;
+        self.thread = {
+            [this, &self]() {
+                run(self);
+                return nullptr;
+            }
+        };
+        self.index = self.thread.start({ self.core.index }) ? 0 : -1U;
+    }
+    std::erase_if(workers, [](const std::unique_ptr<Worker> &w) { return w->index == -1U; });
+
+    for (std::uint32_t i = 0; i < workers.size(); ++i) {
+        workers[i]->index = i;
+        ++numClassWorkers[static_cast<std::uint32_t>(workers[i]->coreClass)];
+    }
+    buildVictims(cpu);
+
+    ready.store(true, std::memory_order_release);
+    ready.notify_all();
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+
+    stopping.store(true, std::memory_order_seq_cst);
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    epoch.notify_all();
+
+    for (auto &w: workers) {
+        w->thread.join();
+    }
+}
+
+void ThreadPool::buildVictims(const Processor &cpu) noexcept {
+    const auto n = static_cast<std::uint32_t>(workers.size());
+
+    for (std::uint32_t i = 0; i < n; ++i) {
+        Worker &self = *workers[i];
+
+        for (std::uint32_t j = 0; j < n; ++j) {
+            if (j != i) {
+                self.victims.emplace_back(j, getProximity(self.core, workers[j]->core));
+            }
+        }
+
+        // Nearest level first; remote nodes by distance; inside a level start after ourselves
+        // so thieves sharing a level fan out over different victims.
+        std::sort(self.victims.begin(), self.victims.end(), [&](const auto &a, const auto &b) {
+            const auto key = [&](const std::pair<std::uint32_t, Proximity> &v) {
+                return std::make_tuple(v.second, cpu.getNumaDistance(self.core.node, workers[v.first]->core.node), (v.first + n - i) % n);
+            };
+            return key(a) < key(b);
+        });
+    }
+}
+
+std::uint32_t ThreadPool::currentWorker() const noexcept {
+    return currentPool == this ? currentIndex : -1U;
+}
+
+void ThreadPool::TaskQueue::push(Func *task) noexcept {
+    std::lock_guard guard { lock };
+    tasks.push_back(task);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+Func * ThreadPool::TaskQueue::pop() noexcept {
+    if (!count.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    std::lock_guard guard { lock };
+    if (tasks.empty()) {
+        return nullptr;
+    }
+
+    Func *task = tasks.front();
+    tasks.pop_front();
+    count.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void ThreadPool::schedule(Func *task, WorkClass workClass) noexcept {
+    if (workers.empty()) {
+        task->call();
+        delete task;
+        pending.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    // A class with no workers of its own just runs anywhere.
+    if (workClass == WorkClass::LatencyCritical && numClassWorkers[static_cast<std::uint32_t>(CoreClass::Performance)]) {
+        critical.push(task);
+    } else if (workClass == WorkClass::Background && numClassWorkers[static_cast<std::uint32_t>(CoreClass::Efficiency)]) {
+        background.push(task);
+    } else if (currentPool == this) {
+        workers[currentIndex]->deque.push(task);
+    } else {
+        injected.push(task);
+    }
+
+    // Pairs with the sleepers increment in run(): either we see the sleeper or it sees the task.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        // Class queues are only served by some workers, a single wakeup may hit the wrong one.
+        if (workClass == WorkClass::Default) {
+            epoch.notify_one();
+        } else {
+            epoch.notify_all();
+        }
+    }
+}
+
+void ThreadPool::wait() noexcept {
+    for (auto p = pending.load(std::memory_order_acquire); p; p = pending.load(std::memory_order_acquire)) {
+        pending.wait(p, std::memory_order_acquire);
+    }
+}
+
+void ThreadPool::run(Worker &self) noexcept {
+    ready.wait(false, std::memory_order_acquire);
+
+    currentPool = this;
+    currentIndex = self.index;
+
+    for (;;) {
+        Func *task = nullptr;
+
+        for (std::uint32_t spin = 0; !task && spin < 64; ++spin) {
+            if (!(task = findTask(self))) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (!task) {
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            const std::uint32_t e = epoch.load(std::memory_order_seq_cst);
+
+            if (!(task = findTask(self))) {
+                if (stopping.load(std::memory_order_acquire)) {
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
+                    break;
+                }
+                epoch.wait(e, std::memory_order_seq_cst);
+            }
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+            if (!task) {
+                continue;
+            }
+        }
+
+        task->call();
+        delete task;
+
+        self.executed.fetch_add(1, std::memory_order_relaxed);
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            pending.notify_all();
+        }
+    }
+
+    currentPool = nullptr;
+    currentIndex = -1U;
+}
+
+Func * ThreadPool::findTask(Worker &self) noexcept {
+    Func *task;
+
+    if (self.deque.pop(task)) {
+        return task;
+    }
+
+    const bool efficiency = self.coreClass == CoreClass::Efficiency;
+
+    if ((task = efficiency ? background.pop() : critical.pop())) {
+        return task;
+    }
+
+    if ((task = injected.pop()) || (task = steal(self))) {
+        return task;
+    }
+
+    return efficiency ? nullptr : background.pop();
+}
+
+Func * ThreadPool::steal(Worker &self) noexcept {
+    Func *task;
+
+    if (order == StealOrder::Proximity) {
+        for (const auto &[victim, proximity]: self.victims) {
+            if (workers[victim]->deque.steal(task)) {
+                self.steals[static_cast<std::uint32_t>(proximity)].fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+    } else {
+        for (std::size_t attempt = 0; attempt < self.victims.size(); ++attempt) {
+            // xorshift64
+            self.rng ^= self.rng << 13;
+            self.rng ^= self.rng >> 7;
+            self.rng ^= self.rng << 17;
+
+            const auto &[victim, proximity] = self.victims[self.rng % self.victims.size()];
+            if (workers[victim]->deque.steal(task)) {
+                self.steals[static_cast<std::uint32_t>(proximity)].fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+    }
+
+    if (!self.victims.empty()) {
+        self.failedSteals.fetch_add(1, std::memory_order_relaxed);
+    }
+    return nullptr;
+}
+
+ThreadPool::Stats ThreadPool::getStats() const noexcept {
+    Stats stats {};
+    for (const auto &w: workers) {
+        stats.executed += w->executed.load(std::memory_order_relaxed);
+        for (std::uint32_t i = 0; i < numProximityLevels; ++i) {
+            stats.steals[i] += w->steals[i].load(std::memory_order_relaxed);
+        }
+        stats.failedSteals += w->failedSteals.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void ThreadPool::resetStats() noexcept {
+    for (auto &w: workers) {
+        w->executed.store(0, std::memory_order_relaxed);
+        for (auto &s: w->steals) {
+            s.store(0, std::memory_order_relaxed);
+        }
+        w->failedSteals.store(0, std::memory_order_relaxed);
+    }
+}
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+#ifndef SYS_THREAD_POOL_H
+#define SYS_THREAD_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ChaseLevDeque.h"
+#include "CpuSet.h"
+#include "Processor.h"
+#include "Thread.h"
+
+namespace sys {
+
+enum class StealOrder : std::uint32_t {
+    Proximity,  // SMT sibling, shared L2, shared L3, same node, then remote by NUMA distance.
+    Random,     // Uniformly random victims, the topology-blind baseline.
+};
+
+// Work-stealing pool with one worker pinned to each selected logical CPU.
+// Tasks submitted from a worker go to its own deque, tasks from elsewhere to a shared queue.
+// Tasks tagged with a WorkClass bypass the deques: latency-critical ones only run on P-core
+// workers, background ones fill E-core workers and reach P-cores only when those are idle.
+class ThreadPool {
+public:
+    struct Stats {
+        std::uint64_t   executed;
+        std::uint64_t   steals[numProximityLevels];  // successful steals by victim proximity
+        std::uint64_t   failedSteals;
+    };
+
+    // One worker per CPU of the process's cgroup budget (getCpuBudget()), cores before SMT siblings.
+    explicit        ThreadPool(const Processor &cpu, StealOrder order = StealOrder::Proximity) noexcept;
+                    ThreadPool(const Processor &cpu, const CpuSet &cpus, StealOrder order = StealOrder::Proximity) noexcept;
+                    ~ThreadPool();
+
+                    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &    operator=(const ThreadPool &) = delete;
+
+    template <class Fn>
+    void            submit(Fn &&fn) noexcept;
+    template <class Fn>
+    void            submit(Fn &&fn, WorkClass workClass) noexcept;
+
+    // Blocks until every submitted task, including tasks they spawned, has run.
+    void            wait() noexcept;
+
+    std::uint32_t   size() const noexcept { return static_cast<std::uint32_t>(workers.size()); }
+    // Index of the calling worker in this pool, -1U from any other thread.
+    std::uint32_t   currentWorker() const noexcept;
+    const LogicalCore & getCore(std::uint32_t worker) const noexcept { return workers[worker]->core; }
+
+    Stats           getStats() const noexcept;
+    void            resetStats() noexcept;
+
+private:
+    struct alignas(cacheLineAlign) Worker {
+        LogicalCore             core;
+        CoreClass               coreClass;
+        ChaseLevDeque<Func *>   deque;
+        std::vector<std::pair<std::uint32_t, Proximity>> victims;
+        std::uint64_t           rng;
+        std::uint32_t           index;
+        Thread                  thread;
+
+        std::atomic<std::uint64_t> executed { 0 };
+        std::atomic<std::uint64_t> steals[numProximityLevels] {};
+        std::atomic<std::uint64_t> failedSteals { 0 };
+    };
+
+    struct TaskQueue {
+        std::mutex                  lock;
+        std::deque<Func *>          tasks;
+        std::atomic<std::uint64_t>  count { 0 };
+
+        void        push(Func *task) noexcept;
+        Func *      pop() noexcept;
+    };
+
+    void            schedule(Func *task, WorkClass workClass) noexcept;
+    void            run(Worker &self) noexcept;
+    Func *          findTask(Worker &self) noexcept;
+    Func *          steal(Worker &self) noexcept;
+    void            buildVictims(const Processor &cpu) noexcept;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    StealOrder                  order;
+
+    TaskQueue                   injected;
+    TaskQueue                   critical;
+    TaskQueue                   background;
+    std::uint32_t               numClassWorkers[2] {};
+
+    alignas(cacheLineAlign) std::atomic<std::uint64_t> pending { 0 };
+    alignas(cacheLineAlign) std::atomic<std::uint32_t> epoch { 0 };
+    std::atomic<std::uint32_t>  sleepers { 0 };
+    std::atomic<bool>           stopping { false };
+    std::atomic<bool>           ready { false };
+};
+
+template <class Fn>
+void ThreadPool::submit(Fn &&fn) noexcept {
+    submit(std::forward<Fn>(fn), WorkClass::Default);
+}
+
+template <class Fn>
+void ThreadPool::submit(Fn &&fn, WorkClass workClass) noexcept {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    schedule(new ThreadFunc<std::decay_t<Fn>>(std::decay_t<Fn>(std::forward<Fn>(fn))), workClass);
+}
+
+}
+
+#endif // SYS_THREAD_POOL_H
@@ -0,0 +1,290 @@
+#include "TopologyCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CpuSet.h"
+#include "Sysfs.h"
+
+namespace sys {
+
+static constexpr const char *onlinePath = "/sys/devices/system/cpu/online";
+static constexpr std::size_t sectionAlign = 16;
+
+std::uint64_t getMicrocodeRevision() noexcept {
+    std::uint64_t revision = 0;
+    if (sysfs::readUInt("/sys/devices/system/cpu/cpu0/microcode/version", revision)) {
+        return revision;
+    }
+
+    // Older kernels and most hypervisors only have it in cpuinfo: "microcode\t: 0xf0".
+    char buf[4096];
+    if (sysfs::readString("/proc/cpuinfo", buf, sizeof(buf))) {
+        if (const char *p = std::strstr(buf, "microcode")) {
+            if ((p = std::strchr(p, ':'))) {
+                revision = std::strtoull(p + 1, nullptr, 0);
+            }
+        }
+    }
+    return revision;
+}
+
+template <class T>
+static bool getSection(const void *base, std::size_t size, const TopologyCacheSection &section, std::span<const T> &out) noexcept {
+    if (section.offset % alignof(T) || section.offset > size || section.count > (size - section.offset) / sizeof(T)) {
+        return false;
+    }
+    out = { reinterpret_cast<const T *>(static_cast<const unsigned char *>(base) + section.offset), section.count };
+    return true;
+}
+
+bool TopologyCacheView::parse(const void *data, std::size_t size) noexcept {
+    if (size < sizeof(TopologyCacheHeader) || reinterpret_cast<std::uintptr_t>(data) % alignof(TopologyCacheHeader)) {
+        return false;
+    }
+
+    const auto &h = *static_cast<const TopologyCacheHeader *>(data);
+    if (h.magic != topologyCacheMagic || h.version != topologyCacheVersion || h.size != size ||
+        h.layout != topologyCacheLayout || h.probeName[sizeof(h.probeName) - 1]) {
+        return false;
+    }
+
+    if (!getSection(data, size, h.online, online) || !getSection(data, size, h.leaves, leaves) ||
+        !getSection(data, size, h.extLeaves, extLeaves) || !getSection(data, size, h.cores, cores) ||
+        !getSection(data, size, h.caches, caches) || !getSection(data, size, h.nodes, nodes) ||
+        !getSection(data, size, h.distances, distances) || leaves.size() < 2 || cores.empty()) {
+        return false;
+    }
+
+    const auto validCache = [&](std::uint32_t index) noexcept { return index == -1U || index < caches.size(); };
+    for (const LogicalCore &core: cores) {
+        if (!validCache(core.l1i) || !validCache(core.l1d) || !validCache(core.l2) || !validCache(core.l3)) {
+            return false;
+        }
+    }
+    for (const TopologyCacheEntry &entry: caches) {
+        if (!validCache(entry.parent)) {
+            return false;
+        }
+    }
+    for (const TopologyCacheNode &node: nodes) {
+        if (node.distances > distances.size() || distances.size() - node.distances < nodes.size()) {
+            return false;
+        }
+    }
+
+    header = &h;
+    return true;
+}
+
+bool Processor::loadCache(const char *path) noexcept {
+#ifdef _MSC_VER
+    return false;
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *base = MAP_FAILED;
+    const bool sized = fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(TopologyCacheHeader) && st.st_size <= 0xFFFFFFFF;
+    if (sized) {
+        base = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+
+    const auto reject = [&]() noexcept {
+        munmap(base, size);
+        return false;
+    };
+
+    TopologyCacheView view;
+    if (!view.parse(base, size)) {
+        return reject();
+    }
+
+    // Key: same CPU model and microcode, same CPUs online and the same ones available to us.
+    const TopologyCacheHeader &header = *view.header;
+    if (std::memcmp(header.vendorId, vendorId, sizeof(vendorId)) || std::memcmp(header.brand, brand, sizeof(brand)) ||
+        header.microcode != getMicrocodeRevision()) {
+        return reject();
+    }
+
+    CpuSet current;
+    sysfs::readCpuList(onlinePath, current);
+    for (std::uint32_t i = 0; i < std::max<std::uint32_t>(view.online.size(), current.size()); ++i) {
+        const CpuSet::Word stored = i < view.online.size() ? view.online[i] : 0;
+        if (stored != (i < current.size() ? current.words()[i] : 0)) {
+            return reject();
+        }
+    }
+
+    const CpuSet affinity = CpuSet::fromAffinity();
+    if (affinity.count() != view.cores.size()) {
+        return reject();
+    }
+    for (const LogicalCore &core: view.cores) {
+        if (!affinity.test(core.index)) {
+            return reject();
+        }
+    }
+
+    // Accepted: the flat tables are used in place, the rest is rebuilt around them.
+    cacheMapping = base;
+    cacheMappingSize = size;
+
+    leaves = view.leaves;
+    extLeaves = view.extLeaves;
+    logicalCores = view.cores;
+    features = header.features;
+    xcr0 = header.xcr0;
+    probeName = header.probeName;
+
+    caches.resize(view.caches.size());
+    for (std::size_t i = 0; i < view.caches.size(); ++i) {
+        const TopologyCacheEntry &e = view.caches[i];
+        Cache &cache = caches[i];
+        cache.level      = e.level;
+        cache.type       = e.type;
+        cache.size       = e.size;
+        cache.ways       = e.ways;
+        cache.lineSize   = e.lineSize;
+        cache.partitions = e.partitions;
+        cache.sets       = e.sets;
+        cache.id         = e.id;
+        cache.parent     = e.parent;
+    }
+
+    numaNodes.resize(view.nodes.size());
+    for (std::size_t i = 0; i < view.nodes.size(); ++i) {
+        const TopologyCacheNode &n = view.nodes[i];
+        NumaNode &node = numaNodes[i];
+        node.id       = n.id;
+        node.memTotal = n.memTotal;
+        node.memFree  = 0;
+        readNodeMemory(node);
+        node.distances.assign(view.distances.begin() + n.distances, view.distances.begin() + n.distances + view.nodes.size());
+    }
+
+    for (const LogicalCore &core: logicalCores) {
+        for (const std::uint32_t index: { core.l1i, core.l1d, core.l2, core.l3 }) {
+            if (index != -1U) {
+                caches[index].cpus.set(core.index);
+            }
+        }
+        for (NumaNode &node: numaNodes) {
+            if (node.id == core.node) {
+                node.cpus.set(core.index);
+            }
+        }
+    }
+
+    classifyCores();
+    buildCoreLookup();
+    return true;
+#endif
+}
+
+void Processor::serialize(std::vector<unsigned char> &file) const noexcept {
+    TopologyCacheHeader header {};
+    header.magic     = topologyCacheMagic;
+    header.version   = topologyCacheVersion;
+    header.layout    = topologyCacheLayout;
+    header.microcode = getMicrocodeRevision();
+    header.features  = features;
+    header.xcr0      = xcr0;
+    std::memcpy(header.vendorId, vendorId, sizeof(vendorId));
+    std::memcpy(header.brand, brand, sizeof(brand));
+    std::snprintf(header.probeName, sizeof(header.probeName), "%s", probeName);
+
+    file.assign(sizeof(header), 0);
+
+    const auto append = [&file](const void *data, std::size_t elementSize, std::size_t count) noexcept {
+        file.resize((file.size() + sectionAlign - 1) & ~(sectionAlign - 1));
+        const TopologyCacheSection section { static_cast<std::uint32_t>(file.size()), static_cast<std::uint32_t>(count) };
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        file.insert(file.end(), bytes, bytes + elementSize * count);
+        return section;
+    };
+
+    CpuSet online;
+    sysfs::readCpuList(onlinePath, online);
+
+    std::vector<TopologyCacheEntry> entries;
+    for (const Cache &cache: caches) {
+        entries.push_back({ cache.level, cache.type, cache.size, cache.ways, cache.lineSize, cache.partitions, cache.sets, cache.id, cache.parent });
+    }
+
+    // Distance rows padded to one entry per node, so every row has the same length.
+    std::vector<TopologyCacheNode> nodes;
+    std::vector<std::uint32_t> distances;
+    for (const NumaNode &node: numaNodes) {
+        nodes.push_back({ node.id, static_cast<std::uint32_t>(distances.size()), node.memTotal });
+        for (std::size_t i = 0; i < numaNodes.size(); ++i) {
+            distances.push_back(i < node.distances.size() ? node.distances[i] : -1U);
+        }
+    }
+
+    header.online    = append(online.words(), sizeof(CpuSet::Word), online.size());
+    header.leaves    = append(leaves.data(), sizeof(Regs), leaves.size());
+    header.extLeaves = append(extLeaves.data(), sizeof(Regs), extLeaves.size());
+    header.cores     = append(logicalCores.data(), sizeof(LogicalCore), logicalCores.size());
+    header.caches    = append(entries.data(), sizeof(TopologyCacheEntry), entries.size());
+    header.nodes     = append(nodes.data(), sizeof(TopologyCacheNode), nodes.size());
+    header.distances = append(distances.data(), sizeof(std::uint32_t), distances.size());
+    header.size      = static_cast<std::uint32_t>(file.size());
+    std::memcpy(file.data(), &header, sizeof(header));
+}
+
+void Processor::saveCache(const char *path) const noexcept {
+#ifndef _MSC_VER
+    std::vector<unsigned char> file;
+    serialize(file);
+
+    // Written next to the target and renamed over it, readers only ever map a complete file.
+    char tmp[4096];
+    if (std::snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= static_cast<int>(sizeof(tmp))) {
+        return;
+    }
+
+    const int fd = mkstemp(tmp);
+    if (fd < 0) {
+        return;
+    }
+
+    std::size_t written = 0;
+    while (written < file.size()) {
+        const ssize_t n = write(fd, file.data() + written, file.size() - written);
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+
+    const bool ok = written == file.size() && fchmod(fd, 0644) == 0;
+    close(fd);
+
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+#endif
+}
+
+}
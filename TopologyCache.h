@@ -0,0 +1,93 @@
+#pragma once
+#ifndef SYS_TOPOLOGY_CACHE_H
+#define SYS_TOPOLOGY_CACHE_H
+
+#include <cstdint>
+#include <span>
+
+#include "CpuSet.h"
+#include "Features.h"
+#include "Processor.h"
+
+namespace sys {
+
+// On-disk layout of the topology cache. Written by the probing process and mapped read-only by
+// later ones, which use the leaf and core tables in place. All offsets are from the start of the
+// file; the file is only valid on the machine and in the state its key describes.
+
+inline constexpr std::uint64_t topologyCacheMagic = 0x4F504F5453595300ULL; // "\0SYSTOPO"
+inline constexpr std::uint32_t topologyCacheVersion = 2;
+
+struct TopologyCacheSection {
+    std::uint32_t   offset;
+    std::uint32_t   count;
+};
+
+struct TopologyCacheHeader {
+    std::uint64_t   magic;
+    std::uint32_t   version;
+    std::uint32_t   size;           // whole file
+    std::uint32_t   layout;         // sizeof the record types, catches builds with different structs
+
+    // Key, compared before anything else is used. The affinity mask is implied by the cores.
+    std::uint32_t   vendorId[4];
+    std::uint32_t   brand[12];
+    std::uint64_t   microcode;
+    TopologyCacheSection online;    // CpuSet::Word[]
+
+    TopologyCacheSection leaves;    // Regs[]
+    TopologyCacheSection extLeaves; // Regs[]
+    TopologyCacheSection cores;     // LogicalCore[]
+    TopologyCacheSection caches;    // TopologyCacheEntry[]
+    TopologyCacheSection nodes;     // TopologyCacheNode[]
+    TopologyCacheSection distances; // std::uint32_t[], rows of the nodes
+
+    Features        features;
+    std::uint64_t   xcr0;
+    char            probeName[16];
+};
+
+// Cache without its CPU set, which is rebuilt from the cores' cache indices.
+struct TopologyCacheEntry {
+    std::uint32_t   level;
+    CacheType       type;
+    std::uint32_t   size;
+    std::uint32_t   ways;
+    std::uint32_t   lineSize;
+    std::uint32_t   partitions;
+    std::uint32_t   sets;
+    std::uint32_t   id;
+    std::uint32_t   parent;
+};
+
+// NUMA node without its CPU set, which is rebuilt from the cores' node ids, and without free
+// memory, which is read when the cache is loaded.
+struct TopologyCacheNode {
+    std::uint32_t   id;
+    std::uint32_t   distances;      // first entry in the distances section, one per node
+    std::uint64_t   memTotal;
+};
+
+inline constexpr std::uint32_t topologyCacheLayout =
+    static_cast<std::uint32_t>(sizeof(TopologyCacheHeader) ^ (sizeof(LogicalCore) << 8) ^ (sizeof(TopologyCacheEntry) << 16) ^ (sizeof(TopologyCacheNode) << 24));
+
+// Bounds-checked sections of an image; parse() checks the structure, not the key.
+struct TopologyCacheView {
+    const TopologyCacheHeader *         header { nullptr };
+    std::span<const CpuSet::Word>       online;
+    std::span<const Regs>               leaves;
+    std::span<const Regs>               extLeaves;
+    std::span<const LogicalCore>        cores;
+    std::span<const TopologyCacheEntry> caches;
+    std::span<const TopologyCacheNode>  nodes;
+    std::span<const std::uint32_t>      distances;
+
+    bool            parse(const void *data, std::size_t size) noexcept;
+};
+
+// Microcode revision of CPU 0, 0 when the kernel does not report it.
+std::uint64_t   getMicrocodeRevision() noexcept;
+
+}
+
+#endif // SYS_TOPOLOGY_CACHE_H
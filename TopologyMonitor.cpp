@@ -0,0 +1,204 @@
+#include "TopologyMonitor.h"
+
+#include <cstring>
+
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Cgroup.h"
+#include "Sysfs.h"
+
+namespace sys {
+
+// Monitor whose watcher is the calling thread, if any.
+static thread_local const TopologyMonitor *watching = nullptr;
+
+TopologyMonitor::TopologyMonitor(ProbeBackend backend, std::chrono::milliseconds pollInterval) noexcept
+    : backend{ backend }, pollInterval{ pollInterval }, snapshot{ std::make_shared<const TopologySnapshot>(1, backend) }, state{ readState() } {
+}
+
+TopologyMonitor::~TopologyMonitor() {
+    stop();
+}
+
+TopologyMonitor::State TopologyMonitor::readState() noexcept {
+    State s;
+    sysfs::readCpuList("/sys/devices/system/cpu/online", s.online);
+    s.usable = getCpuBudget().cpus;
+    return s;
+}
+
+bool TopologyMonitor::start() noexcept {
+#ifdef _MSC_VER
+    return false;
+#else
+    if (running) {
+        return true;
+    }
+    if (pipe2(wakeup, O_CLOEXEC | O_NONBLOCK) != 0) {
+        return false;
+    }
+
+    // Kernel uevents (group 1). Fails in a network namespace without them; polling covers that.
+    netlink = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (netlink >= 0) {
+        sockaddr_nl address {};
+        address.nl_family = AF_NETLINK;
+        address.nl_groups = 1;
+        if (bind(netlink, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+            close(netlink);
+            netlink = -1;
+        }
+    }
+
+    stopping.store(false, std::memory_order_relaxed);
+    watcher = {
+        [this]() {
+            run();
+            return nullptr;
+        }
+    };
+    const bool started = watcher.start(CpuSet::fromAffinity());
+    std::lock_guard lock { requestMutex };
+    running = started;
+    return started;
+#endif
+}
+
+void TopologyMonitor::stop() noexcept {
+#ifndef _MSC_VER
+    if (running) {
+        stopping.store(true, std::memory_order_relaxed);
+        const char byte = 0;
+        [[maybe_unused]] const ssize_t n = write(wakeup[1], &byte, 1);
+        watcher.join();
+
+        // Callers still waiting in refresh() give up on the watcher; later ones check themselves.
+        std::lock_guard lock { requestMutex };
+        running = false;
+        requestDone.notify_all();
+    }
+    for (int *fd: { &netlink, &wakeup[0], &wakeup[1] }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+#endif
+}
+
+void TopologyMonitor::run() noexcept {
+#ifndef _MSC_VER
+    char buffer[8192];
+    watching = this;
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+        pollfd fds[2] = { { wakeup[0], POLLIN, 0 }, { netlink, POLLIN, 0 } };
+        const int ready = poll(fds, netlink >= 0 ? 2 : 1, static_cast<int>(pollInterval.count()));
+        if (stopping.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        // Drain the socket; only CPU device events ("online@/devices/system/cpu/cpu3") matter,
+        // everything else just shares the multicast group.
+        bool cpuEvent = false;
+        if (ready > 0 && (fds[1].revents & POLLIN)) {
+            ssize_t n;
+            while ((n = recv(netlink, buffer, sizeof(buffer) - 1, 0)) > 0) {
+                buffer[n] = '\0';
+                cpuEvent = cpuEvent || std::strstr(buffer, "@/devices/system/cpu/cpu") != nullptr;
+            }
+        }
+
+        // Wakeups are refresh() requests, or stop() which was checked above.
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            while (read(wakeup[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        std::uint64_t pending;
+        {
+            std::lock_guard lock { requestMutex };
+            pending = requested;
+        }
+
+        // A timeout is the poll for what has no events; a CPU event or a request is checked right away.
+        if (ready == 0 || cpuEvent || pending != served) {
+            update();
+        }
+
+        std::lock_guard lock { requestMutex };
+        served = pending;
+        requestDone.notify_all();
+    }
+#endif
+}
+
+bool TopologyMonitor::refresh() noexcept {
+#ifndef _MSC_VER
+    if (watching != this) {
+        const std::uint64_t version = getVersion();
+
+        // running only changes under requestMutex, so the pipe stays open while it is held.
+        std::unique_lock lock { requestMutex };
+        if (running) {
+            const std::uint64_t ticket = ++requested;
+            const char byte = 1;
+            [[maybe_unused]] const ssize_t n = write(wakeup[1], &byte, 1);
+            requestDone.wait(lock, [&]() { return served >= ticket || !running; });
+            return getVersion() != version;
+        }
+    }
+#endif
+    return update();
+}
+
+bool TopologyMonitor::update() noexcept {
+    std::unique_lock lock { refreshMutex };
+
+    const State now = readState();
+    if (now == state) {
+        return false;
+    }
+
+    const Snapshot previous = current();
+    const Snapshot next = std::make_shared<const TopologySnapshot>(previous->version + 1, *previous, backend);
+
+    TopologyChange change { next->version, {}, {} };
+    CpuSet before, after;
+    for (const LogicalCore &core: previous->processor.getCores()) {
+        before.set(core.index);
+    }
+    for (const LogicalCore &core: next->processor.getCores()) {
+        after.set(core.index);
+    }
+    change.added = (after - before) | (now.usable - state.usable);
+    change.removed = (before - after) | (state.usable - now.usable);
+
+    state = now;
+    snapshot.store(next, std::memory_order_release);
+    lock.unlock();
+
+    std::lock_guard subscriberLock { subscriberMutex };
+    for (const auto &[id, subscriber]: subscribers) {
+        subscriber(next, change);
+    }
+    return true;
+}
+
+std::uint32_t TopologyMonitor::subscribe(Subscriber subscriber) noexcept {
+    std::lock_guard lock { subscriberMutex };
+    subscribers.emplace_back(++nextId, std::move(subscriber));
+    return nextId;
+}
+
+void TopologyMonitor::unsubscribe(std::uint32_t id) noexcept {
+    std::lock_guard lock { subscriberMutex };
+    std::erase_if(subscribers, [id](const auto &entry) { return entry.first == id; });
+}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef SYS_TOPOLOGY_MONITOR_H
+#define SYS_TOPOLOGY_MONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CpuSet.h"
+#include "Processor.h"
+#include "Thread.h"
+
+namespace sys {
+
+// Immutable topology at one point in time. Readers keep the snapshot they loaded alive for as long
+// as they hold it, a newer one never modifies it.
+struct TopologySnapshot {
+                    TopologySnapshot(std::uint64_t version, ProbeBackend backend) noexcept
+                        : version{ version }, processor{ backend } {}
+                    TopologySnapshot(std::uint64_t version, const TopologySnapshot &previous, ProbeBackend backend) noexcept
+                        : version{ version }, processor{ previous.processor, backend } {}
+
+    std::uint64_t   version;
+    Processor       processor;
+};
+
+struct TopologyChange {
+    std::uint64_t   version;
+    CpuSet          added;      // CPUs usable now that were not before
+    CpuSet          removed;    // CPUs no longer usable: offline, or outside our affinity
+};
+
+// Watches for CPU hotplug and affinity/cpuset changes and publishes a new TopologySnapshot when the
+// usable CPUs change. Hotplug arrives over the kernel uevent netlink socket; cpusets and affinity
+// give no notification, so they, and hotplug where netlink is unavailable (e.g. in a network
+// namespace), are polled. Only CPUs the previous snapshot did not know are probed.
+//
+// The watcher thread inherits the affinity of the thread that called start(), which is what it
+// compares against and probes with. refresh() hands the re-probe to it, so the caller's own
+// affinity does not matter while the watcher runs.
+class TopologyMonitor {
+public:
+    using Snapshot = std::shared_ptr<const TopologySnapshot>;
+    // Runs after the new snapshot is published, on the watcher thread while it runs and otherwise on
+    // the thread that called refresh(); must not (un)subscribe.
+    using Subscriber = std::function<void(const Snapshot &snapshot, const TopologyChange &change)>;
+
+    explicit        TopologyMonitor(ProbeBackend backend = ProbeBackend::Auto, std::chrono::milliseconds pollInterval = std::chrono::seconds(1)) noexcept;
+                    ~TopologyMonitor();
+
+                    TopologyMonitor(const TopologyMonitor &) = delete;
+    TopologyMonitor &operator=(const TopologyMonitor &) = delete;
+
+    // Starts the watcher thread; false when it cannot be started.
+    bool            start() noexcept;
+    void            stop() noexcept;
+
+    // Current snapshot, a reference count increment; never blocks on a refresh in progress.
+    Snapshot        current() const noexcept { return snapshot.load(std::memory_order_acquire); }
+    std::uint64_t   getVersion() const noexcept { return current()->version; }
+    bool            hasNetlink() const noexcept { return netlink >= 0; }
+
+    // Returns an id for unsubscribe().
+    std::uint32_t   subscribe(Subscriber subscriber) noexcept;
+    void            unsubscribe(std::uint32_t id) noexcept;
+
+    // Checks now, from any thread, and waits for the result; true when a new snapshot was published.
+    bool            refresh() noexcept;
+
+private:
+    // What a change is detected on: the online mask and the CPUs our affinity and cgroup allow.
+    struct State {
+        CpuSet      online;
+        CpuSet      usable;
+
+        bool        operator==(const State &rhs) const noexcept { return online == rhs.online && usable == rhs.usable; }
+    };
+
+    static State    readState() noexcept;
+    void            run() noexcept;
+    // The check itself, on the watcher thread or, when it does not run, on refresh()'s caller.
+    bool            update() noexcept;
+
+    ProbeBackend                        backend;
+    std::chrono::milliseconds           pollInterval;
+    std::atomic<Snapshot>               snapshot;
+    std::mutex                          refreshMutex;   // one refresh at a time; readers never take it
+    State                               state;
+
+    std::mutex                          subscriberMutex;
+    std::vector<std::pair<std::uint32_t, Subscriber>> subscribers;
+    std::uint32_t                       nextId { 0 };
+
+    // refresh() calls waiting for the watcher: tickets handed out and the last one it served.
+    std::mutex                          requestMutex;
+    std::condition_variable             requestDone;
+    std::uint64_t                       requested { 0 };
+    std::uint64_t                       served { 0 };
+
+    Thread                              watcher;
+    std::atomic<bool>                   stopping { false };
+    bool                                running { false };  // written under requestMutex
+    int                                 netlink { -1 };
+    int                                 wakeup[2] { -1, -1 };  // pipe that interrupts the wait on stop()
+};
+
+}
+
+#endif // SYS_TOPOLOGY_MONITOR_H
@@ -0,0 +1,204 @@
+#include "TopologyProbe.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Thread.h"
+
+namespace sys {
+
+// CPUID executed by the calling thread; only meaningful while pinned to the CPU being probed.
+struct NativeCpuidReader final : public CpuidReader {
+    bool read(std::uint32_t leaf, std::uint32_t subleaf, Regs &regs) const noexcept override {
+#ifdef _MSC_VER
+        __get_cpuid_count(leaf, subleaf, &regs.eax, &regs.ebx, &regs.ecx, &regs.edx);
+        return true;
+#else
+        // __get_cpuid_count() checks against the basic or extended maximum only, the hypervisor
+        // range 0x40000000 would always fail it; callers check that range's maximum themselves.
+        if ((leaf & 0xF0000000) == 0x40000000) {
+            __cpuid_count(leaf, subleaf, regs.eax, regs.ebx, regs.ecx, regs.edx);
+            return true;
+        }
+        return __get_cpuid_count(leaf, subleaf, &regs.eax, &regs.ebx, &regs.ecx, &regs.edx) != 0;
+#endif
+    }
+};
+
+static const NativeCpuidReader nativeCpuid;
+
+const CpuidReader & getNativeCpuidReader() noexcept {
+    return nativeCpuid;
+}
+
+// One pinned thread per CPU. This is the original probe and works everywhere.
+class ThreadsProbe final : public TopologyProbe {
+public:
+    const char *name() const noexcept override { return "threads"; }
+    bool        available() const noexcept override { return true; }
+
+    bool run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept override {
+        std::vector<Thread> threads(cpus.size());
+        bool ok = true;
+
+        std::uint32_t i = 0;
+        for (auto &th: threads) {
+            const std::uint32_t cpu = cpus[i];
+            th = {
+                [&visitor, i, cpu]() {
+                    visitor.visit(i, cpu, nativeCpuid);
+                    return nullptr;
+                }
+            };
+            ok &= th.start({ cpu });
+            ++i;
+        }
+
+        for (auto &th: threads) {
+            th.join();
+        }
+
+        return ok;
+    }
+};
+
+// A single thread that moves itself from CPU to CPU.
+class MigrateProbe final : public TopologyProbe {
+public:
+    const char *name() const noexcept override { return "migrate"; }
+    bool        available() const noexcept override { return true; }
+
+    bool run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept override {
+        if (cpus.empty()) {
+            return true;
+        }
+
+        bool ok = true;
+
+        Thread th {
+            [&]() {
+                std::uint32_t i = 0;
+                for (const std::uint32_t cpu: cpus) {
+                    if (!pinSelf(cpu)) {
+                        ok = false;
+                        break;
+                    }
+                    visitor.visit(i++, cpu, nativeCpuid);
+                }
+                return nullptr;
+            }
+        };
+
+        if (!th.start({ cpus[0] })) {
+            return false;
+        }
+        th.join();
+
+        return ok;
+    }
+
+private:
+    static bool pinSelf(std::uint32_t cpu) noexcept {
+#ifdef _MSC_VER
+        return SetThreadAffinityMask(GetCurrentThread(), 1ULL << cpu) != 0;
+#else
+        const CpuSet set { cpu };
+
+        // The kernel migrates the caller before sched_setaffinity returns.
+        return sched_setaffinity(0, set.byteSize(), set.data()) == 0 && sched_getcpu() == static_cast<int>(cpu);
+#endif
+    }
+};
+
+#if !defined(_MSC_VER)
+// Reads CPUID through the cpuid driver: the file offset selects leaf (low) and subleaf (high).
+struct DevCpuidReader final : public CpuidReader {
+    int fd { -1 };
+
+    bool read(std::uint32_t leaf, std::uint32_t subleaf, Regs &regs) const noexcept override {
+        const off_t offset = static_cast<off_t>(leaf) | (static_cast<off_t>(subleaf) << 32);
+        return pread(fd, &regs, sizeof(Regs), offset) == sizeof(Regs);
+    }
+};
+#endif
+
+// No threads at all: sysfs tells us which CPUs are online and /dev/cpu/N/cpuid answers for them.
+class SysfsProbe final : public TopologyProbe {
+public:
+    const char *name() const noexcept override { return "sysfs"; }
+
+    bool available() const noexcept override {
+#ifdef _MSC_VER
+        return false;
+#else
+        const int fd = open("/dev/cpu/0/cpuid", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        return true;
+#endif
+    }
+
+    bool run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept override {
+#ifdef _MSC_VER
+        return false;
+#else
+        char path[64];
+        DevCpuidReader reader;
+
+        std::uint32_t i = 0;
+        for (const std::uint32_t cpu: cpus) {
+            struct stat st;
+            std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology", cpu);
+            if (stat(path, &st) != 0) {
+                return false;
+            }
+
+            std::snprintf(path, sizeof(path), "/dev/cpu/%u/cpuid", cpu);
+            reader.fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (reader.fd < 0) {
+                return false;
+            }
+
+            visitor.visit(i++, cpu, reader);
+            close(reader.fd);
+        }
+
+        return true;
+#endif
+    }
+};
+
+static const SysfsProbe     sysfsProbe;
+static const MigrateProbe   migrateProbe;
+static const ThreadsProbe   threadsProbe;
+
+const TopologyProbe * getTopologyProbe(ProbeBackend backend) noexcept {
+    switch (backend) {
+    case ProbeBackend::Threads: return &threadsProbe;
+    case ProbeBackend::Migrate: return &migrateProbe;
+    case ProbeBackend::Sysfs:   return &sysfsProbe;
+    case ProbeBackend::None:    return nullptr;
+    case ProbeBackend::Auto:    break;
+    }
+
+    // Cheapest first: a few syscalls per CPU, then one thread, then one thread per CPU.
+    for (const TopologyProbe *probe: { static_cast<const TopologyProbe *>(&sysfsProbe), static_cast<const TopologyProbe *>(&migrateProbe) }) {
+        if (probe->available()) {
+            return probe;
+        }
+    }
+
+    return &threadsProbe;
+}
+
+}
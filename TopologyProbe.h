@@ -0,0 +1,51 @@
+#pragma once
+#ifndef SYS_TOPOLOGY_PROBE_H
+#define SYS_TOPOLOGY_PROBE_H
+
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "Processor.h"
+
+namespace sys {
+
+// Answers CPUID queries as if executed on one particular logical CPU.
+struct CpuidReader {
+                    virtual ~CpuidReader() = default;
+    virtual bool    read(std::uint32_t leaf, std::uint32_t subleaf, Regs &regs) const noexcept = 0;
+};
+
+// Called once per probed CPU. May be invoked concurrently for different indices.
+struct ProbeVisitor {
+                    virtual ~ProbeVisitor() = default;
+    virtual void    visit(std::uint32_t index, std::uint32_t cpu, const CpuidReader &cpuid) noexcept = 0;
+};
+
+template <class Fn>
+struct ProbeFunc : public ProbeVisitor {
+    Fn      func;
+
+            ProbeFunc(Fn &&func) noexcept : func(std::forward<Fn>(func)) {}
+    void    visit(std::uint32_t index, std::uint32_t cpu, const CpuidReader &cpuid) noexcept override { func(index, cpu, cpuid); }
+};
+
+class TopologyProbe {
+public:
+                        virtual ~TopologyProbe() = default;
+
+    virtual const char *name() const noexcept = 0;
+    virtual bool        available() const noexcept = 0;
+    virtual bool        run(std::span<const std::uint32_t> cpus, ProbeVisitor &visitor) const noexcept = 0;
+};
+
+// CPUID on the calling thread, for probes that arrange to run on each CPU themselves.
+const CpuidReader &     getNativeCpuidReader() noexcept;
+
+// Returns the requested backend, or the cheapest available one for ProbeBackend::Auto.
+// nullptr for ProbeBackend::None.
+const TopologyProbe *   getTopologyProbe(ProbeBackend backend) noexcept;
+
+}
+
+#endif // SYS_TOPOLOGY_PROBE_H
@@ -0,0 +1,291 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "TopologyProbe.h"
+
+namespace sys {
+
+namespace {
+
+// Cold state: touched when a thread attaches, an event is defined or a trace is written.
+struct Registry {
+    std::mutex                              mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;      // kept after their thread exits until flushed
+    std::vector<std::unique_ptr<TraceRing>> spare;      // flushed rings of exited threads, for attach()
+    std::vector<std::string>                names;
+    std::uint32_t                           capacity { 1 << 14 };
+};
+
+Registry &registry() noexcept {
+    static Registry instance;
+    return instance;
+}
+
+std::uint64_t currentThreadId() noexcept {
+#ifdef _MSC_VER
+    return GetCurrentThreadId();
+#else
+    return static_cast<std::uint64_t>(syscall(SYS_gettid));
+#endif
+}
+
+void writeString(std::FILE *file, const std::string &s) noexcept {
+    std::fputc('"', file);
+    for (const char c: s) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            std::fputc(c, file);
+        }
+    }
+    std::fputc('"', file);
+}
+
+}
+
+TraceRing::TraceRing(std::uint32_t capacity, std::uint64_t thread, CpuIdSource source) noexcept
+    : events{ new TraceEvent[capacity] }, mask{ capacity - 1U }, thread{ thread }, source{ source } {
+}
+
+CpuIdSource TraceRing::chooseSource() noexcept {
+    const CpuidReader &cpuid = getNativeCpuidReader();
+    Regs regs {};
+    const bool rdpid = cpuid.read(0, 0, regs) && regs.eax >= 7 && cpuid.read(7, 0, regs) && (regs.ecx & (1U << 22));
+    const bool rdtscp = cpuid.read(0x80000001, 0, regs) && (regs.edx & (1U << 27));
+
+    // As Processor::currentCpu(): trust TSC_AUX only if it agrees with the OS in one of a few
+    // reads, the others may have migrated.
+    const auto agrees = [](CpuIdSource source) noexcept {
+        TraceRing probe { 1, 0, source };
+        for (int i = 0; i < 4; ++i) {
+            probe.push(0, TracePhase::Instant, 0);
+#ifdef _MSC_VER
+            const std::uint32_t os = GetCurrentProcessorNumber();
+#else
+            const std::uint32_t os = static_cast<std::uint32_t>(sched_getcpu());
+#endif
+            if (probe.events[0].cpu == (os & 0xFFF)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (rdpid && agrees(CpuIdSource::Rdpid)) {
+        return CpuIdSource::Rdpid;
+    }
+    if (rdtscp && agrees(CpuIdSource::Rdtscp)) {
+        return CpuIdSource::Rdtscp;
+    }
+    return CpuIdSource::Getcpu;
+}
+
+std::uint16_t Tracer::defineEvent(const char *name) noexcept {
+    Registry &r = registry();
+    std::lock_guard lock { r.mutex };
+
+    for (std::size_t i = 0; i < r.names.size(); ++i) {
+        if (r.names[i] == name) {
+            return static_cast<std::uint16_t>(i);
+        }
+    }
+    r.names.emplace_back(name);
+    return static_cast<std::uint16_t>(r.names.size() - 1);
+}
+
+void Tracer::setCapacity(std::uint32_t events) noexcept {
+    Registry &r = registry();
+    std::lock_guard lock { r.mutex };
+    r.capacity = std::bit_ceil(std::max(events, 2U));
+}
+
+TraceRing * Tracer::attach() noexcept {
+    static const CpuIdSource source = TraceRing::chooseSource();
+
+    Registry &r = registry();
+    std::lock_guard lock { r.mutex };
+
+    // Reuse the ring of an exited thread unless setCapacity() changed the size since.
+    while (!r.spare.empty() && r.spare.back()->mask + 1 != r.capacity) {
+        r.spare.pop_back();
+    }
+    if (r.spare.empty()) {
+        r.rings.push_back(std::make_unique<TraceRing>(r.capacity, currentThreadId(), source));
+    } else {
+        TraceRing &reused = *r.spare.back();
+        reused.thread = currentThreadId();
+        reused.flushed = 0;
+        reused.exited.store(false, std::memory_order_relaxed);
+        reused.head.store(0, std::memory_order_relaxed);
+        r.rings.push_back(std::move(r.spare.back()));
+        r.spare.pop_back();
+    }
+    ring = r.rings.back().get();
+
+    // Constructed on the thread's first event, destroyed when it exits.
+    struct Exit {
+        ~Exit() {
+            if (ring) {
+                ring->exited.store(true, std::memory_order_release);
+                ring = nullptr;
+            }
+        }
+    };
+    static thread_local Exit exit;
+    (void)exit;
+
+    return ring;
+}
+
+bool Tracer::writeChromeTrace(const char *path, const Processor &cpu, const TscClock &clock) noexcept {
+    struct Thread {
+        std::uint64_t           id;
+        std::vector<TraceEvent> events;
+    };
+
+    Registry &r = registry();
+    std::lock_guard lock { r.mutex };
+
+    // Copy out, then drop what the writer may have overwritten while we copied.
+    std::vector<Thread> threads;
+    std::vector<bool> retired(r.rings.size());
+    std::uint64_t base = -1ULL;
+
+    for (std::size_t index = 0; index < r.rings.size(); ++index) {
+        TraceRing *ring = r.rings[index].get();
+        const std::uint64_t capacity = ring->mask + 1;
+        // Read before head: once the thread has exited, this head is its last.
+        retired[index] = ring->exited.load(std::memory_order_acquire);
+        const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+        std::uint64_t first = std::max(ring->flushed, head > capacity ? head - capacity : 0);
+
+        Thread thread { ring->thread, {} };
+        thread.events.reserve(static_cast<std::size_t>(head - first));
+        for (std::uint64_t i = first; i < head; ++i) {
+            thread.events.push_back(ring->events[i & ring->mask]);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t now = ring->head.load(std::memory_order_relaxed);
+        // The writer may be storing event `now` into the slot of event `now - capacity`; an exited
+        // thread writes nothing.
+        if (!retired[index] && now >= capacity && now - capacity >= first) {
+            thread.events.erase(thread.events.begin(), thread.events.begin() + static_cast<std::ptrdiff_t>(std::min(now - capacity + 1 - first, head - first)));
+        }
+        ring->flushed = head;
+
+        for (const TraceEvent &e: thread.events) {
+            base = std::min(base, e.tsc);
+        }
+        threads.push_back(std::move(thread));
+    }
+
+    for (std::size_t index = retired.size(); index-- > 0;) {
+        if (retired[index]) {
+            r.spare.push_back(std::move(r.rings[index]));
+            r.rings.erase(r.rings.begin() + static_cast<std::ptrdiff_t>(index));
+        }
+    }
+
+    std::FILE *file = std::fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    // One process per package and core class, one track per logical CPU; unknown CPUs share one.
+    constexpr std::uint32_t unknownPid = 0xFFFF;
+    std::vector<const LogicalCore *> byCpu;
+    for (const LogicalCore &core: cpu.getCores()) {
+        byCpu.resize(std::max<std::size_t>(byCpu.size(), core.index + 1));
+        byCpu[core.index] = &core;
+    }
+    const auto pidOf = [&](std::uint32_t index) noexcept {
+        if (index >= byCpu.size() || !byCpu[index]) {
+            return unknownPid;
+        }
+        return byCpu[index]->chip * 2 + static_cast<std::uint32_t>(cpu.getCoreClass(*byCpu[index]));
+    };
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char *separator = "";
+
+    std::vector<std::uint32_t> pids;
+    for (const LogicalCore &core: cpu.getCores()) {
+        const std::uint32_t pid = pidOf(core.index);
+        const bool efficiency = cpu.getCoreClass(core) == CoreClass::Efficiency;
+
+        if (std::find(pids.begin(), pids.end(), pid) == pids.end()) {
+            pids.push_back(pid);
+            std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"package %u %s\"}}", separator, pid, core.chip, efficiency ? "E-cores" : "P-cores");
+            separator = ",\n";
+            std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"process_sort_index\",\"pid\":%u,\"args\":{\"sort_index\":%u}}", separator, pid, pid);
+        }
+        std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"cpu %u (core %u, smt %u)\"}}", separator, pid, core.index, core.index, core.core, core.smt);
+        std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":%u,\"tid\":%u,\"args\":{\"sort_index\":%u}}", separator, pid, core.index, core.index);
+    }
+    std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"unknown cpu\"}}", separator, unknownPid);
+    separator = ",\n";
+
+    const auto micros = [&](std::uint64_t tsc) noexcept {
+        return static_cast<double>(clock.toNanos(tsc - base)) / 1000.0;
+    };
+    const auto writeEvent = [&](const TraceEvent &e, const char *phase) noexcept {
+        std::fprintf(file, "%s{\"ph\":\"%s\",\"name\":", separator, phase);
+        writeString(file, e.id < r.names.size() ? r.names[e.id] : std::string { "?" });
+        std::fprintf(file, ",\"pid\":%u,\"tid\":%u,\"ts\":%.3f", pidOf(e.cpu), e.cpu, micros(e.tsc));
+    };
+
+    for (const Thread &thread: threads) {
+        std::vector<const TraceEvent *> open;
+
+        for (const TraceEvent &e: thread.events) {
+            switch (e.phase) {
+            case TracePhase::Begin:
+                open.push_back(&e);
+                break;
+
+            case TracePhase::End: {
+                // Innermost open scope of the same event; an end without one began before the flushed window.
+                auto it = std::find_if(open.rbegin(), open.rend(), [&](const TraceEvent *b) { return b->id == e.id; });
+                if (it == open.rend()) {
+                    break;
+                }
+                const TraceEvent &b = **it;
+                open.erase(std::next(it).base());
+
+                writeEvent(b, "X");
+                std::fprintf(file, ",\"dur\":%.3f,\"args\":{\"thread\":%llu,\"payload\":%llu,\"end cpu\":%u}}",
+                    micros(e.tsc) - micros(b.tsc), static_cast<unsigned long long>(thread.id), static_cast<unsigned long long>(b.payload), e.cpu);
+                break;
+            }
+
+            case TracePhase::Instant:
+                writeEvent(e, "i");
+                std::fprintf(file, ",\"s\":\"t\",\"args\":{\"thread\":%llu,\"payload\":%llu}}",
+                    static_cast<unsigned long long>(thread.id), static_cast<unsigned long long>(e.payload));
+                break;
+            }
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+#ifndef SYS_TRACE_H
+#define SYS_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Processor.h"
+#include "TscClock.h"
+
+namespace sys {
+
+enum class TracePhase : std::uint8_t {
+    Begin,
+    End,
+    Instant,
+};
+
+struct TraceEvent {
+    std::uint64_t   tsc;
+    std::uint64_t   payload;
+    std::uint32_t   cpu;        // logical CPU the event was recorded on
+    std::uint16_t   id;         // Tracer::defineEvent()
+    TracePhase      phase;
+};
+
+// Events of one thread. Only the owning thread writes; when full the oldest events are overwritten.
+// The flusher reads concurrently and drops whatever the writer may have overwritten meanwhile.
+// Once the thread has exited and its events are flushed, the ring goes to the next new thread.
+class TraceRing {
+public:
+                    TraceRing(std::uint32_t capacity, std::uint64_t thread, CpuIdSource source) noexcept;
+
+    INLINE void     push(std::uint16_t id, TracePhase phase, std::uint64_t payload) noexcept;
+
+private:
+    friend class Tracer;
+
+    // rdpid, rdtscp or sched_getcpu(), whichever is cheapest and agrees with the OS.
+    static CpuIdSource chooseSource() noexcept;
+
+    std::unique_ptr<TraceEvent[]>   events;
+    std::uint64_t                   mask;
+    std::uint64_t                   thread;     // OS thread id
+    CpuIdSource                     source;
+    std::uint64_t                   flushed { 0 };
+    std::atomic<bool>               exited { false };   // set by the owning thread on exit
+    alignas(cacheLineAlign) std::atomic<std::uint64_t> head { 0 };
+};
+
+INLINE void TraceRing::push(std::uint16_t id, TracePhase phase, std::uint64_t payload) noexcept {
+    // IA32_TSC_AUX holds the CPU number: rdpid reads it alone, rdtscp with the time. Without
+    // either, lfence + rdtsc orders the read as rdtscp would and the OS supplies the CPU.
+    std::uint64_t tsc;
+    std::uint32_t cpu;
+    switch (source) {
+    case CpuIdSource::Rdpid: {
+#ifdef _MSC_VER
+        cpu = _rdpid_u32();
+#else
+        std::uint64_t aux;
+        __asm__ volatile ("rdpid %0" : "=r"(aux));
+        cpu = static_cast<std::uint32_t>(aux);
+#endif
+        tsc = __rdtsc();
+        break;
+    }
+    case CpuIdSource::Rdtscp: {
+        unsigned int aux;
+        tsc = __rdtscp(&aux);
+        cpu = aux;
+        break;
+    }
+    default:
+        _mm_lfence();
+        tsc = __rdtsc();
+#ifdef _MSC_VER
+        cpu = GetCurrentProcessorNumber();
+#else
+        cpu = static_cast<std::uint32_t>(sched_getcpu());
+#endif
+        break;
+    }
+
+    const std::uint64_t pos = head.load(std::memory_order_relaxed);
+    events[pos & mask] = { tsc, payload, cpu & 0xFFF, id, phase };
+    head.store(pos + 1, std::memory_order_release);
+}
+
+// Process-wide tracing. The first event of a thread allocates its ring; after that recording is a
+// thread_local load, rdpid or rdtscp and a 24 byte store.
+//
+//     static const auto parse = Tracer::defineEvent("parse");
+//     { TraceScope scope { parse, requestId }; ... }
+//     Tracer::writeChromeTrace("trace.json", cpu, clock);
+class Tracer {
+public:
+    // Event id for a name (copied); the same name gets the same id.
+    static std::uint16_t defineEvent(const char *name) noexcept;
+    // Ring size in events for threads that have not traced yet, rounded up to a power of two.
+    static void     setCapacity(std::uint32_t events) noexcept;
+
+    static INLINE void begin(std::uint16_t id, std::uint64_t payload = 0) noexcept { record(id, TracePhase::Begin, payload); }
+    static INLINE void end(std::uint16_t id, std::uint64_t payload = 0) noexcept { record(id, TracePhase::End, payload); }
+    static INLINE void instant(std::uint16_t id, std::uint64_t payload = 0) noexcept { record(id, TracePhase::Instant, payload); }
+
+    static INLINE void record(std::uint16_t id, TracePhase phase, std::uint64_t payload) noexcept {
+        TraceRing *r = ring;
+        if (!r) [[unlikely]] {
+            r = attach();
+        }
+        r->push(id, phase, payload);
+    }
+
+    // Writes the events recorded since the last flush as Chrome/Perfetto trace JSON and consumes
+    // them. Begin/end pairs become complete events on the track of the CPU they began on; tracks
+    // are grouped by package and core class and ordered by core. Scopes still open are dropped.
+    // False when the file cannot be written.
+    static bool     writeChromeTrace(const char *path, const Processor &cpu, const TscClock &clock) noexcept;
+
+private:
+    static TraceRing *attach() noexcept;
+
+    static inline thread_local TraceRing *ring = nullptr;
+};
+
+class TraceScope {
+public:
+                    TraceScope(std::uint16_t id, std::uint64_t payload = 0) noexcept : id{ id } { Tracer::begin(id, payload); }
+                    ~TraceScope() { Tracer::end(id); }
+
+                    TraceScope(const TraceScope &) = delete;
+    TraceScope &    operator=(const TraceScope &) = delete;
+
+private:
+    std::uint16_t   id;
+};
+
+}
+
+#endif // SYS_TRACE_H
@@ -0,0 +1,86 @@
+#include "TscClock.h"
+
+#include <ctime>
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include "TopologyProbe.h"
+
+namespace sys {
+
+namespace {
+
+std::uint64_t monotonicRawNanos() noexcept {
+#ifdef _MSC_VER
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<std::uint64_t>(static_cast<double>(counter.QuadPart) * 1e9 / static_cast<double>(frequency.QuadPart));
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + static_cast<std::uint64_t>(ts.tv_nsec);
+#endif
+}
+
+struct Sample {
+    std::uint64_t   tsc;
+    std::uint64_t   nanos;
+};
+
+// Clock read bracketed by two TSC reads; the tightest of a few brackets, so a preemption or
+// interrupt between the reads does not skew the pairing.
+Sample sample() noexcept {
+    Sample best {};
+    std::uint64_t bestWidth = -1ULL;
+
+    for (int i = 0; i < 8; ++i) {
+        const std::uint64_t before = TscClock::ticksOrdered();
+        const std::uint64_t nanos = monotonicRawNanos();
+        const std::uint64_t after = TscClock::ticksOrdered();
+
+        if (after - before < bestWidth) {
+            bestWidth = after - before;
+            best = { before + (after - before) / 2, nanos };
+        }
+    }
+    return best;
+}
+
+bool hasRdtscp() noexcept {
+    Regs regs {};
+    return getNativeCpuidReader().read(0x80000001, 0, regs) && (regs.edx & (1U << 27));
+}
+
+}
+
+const bool TscClock::rdtscp = hasRdtscp();
+
+TscClock::TscClock(const Processor &cpu) noexcept
+    : frequency { cpu.getTscFrequency() }, source { Source::Cpuid }, invariant { cpu.hasInvariantTsc() } {
+    if (!frequency) {
+        frequency = calibrate();
+        source = Source::Calibrated;
+    }
+    mult = frequency ? (1000000000ULL << shift) / frequency : 0;
+}
+
+std::uint64_t TscClock::calibrate(std::uint32_t milliseconds) noexcept {
+    const Sample start = sample();
+    const std::uint64_t end = start.nanos + static_cast<std::uint64_t>(milliseconds) * 1000000;
+
+    // Spin rather than sleep, a sleeping CPU may change frequency on parts without invariant TSC.
+    while (monotonicRawNanos() < end) {
+    }
+
+    const Sample stop = sample();
+    if (stop.nanos <= start.nanos) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(static_cast<double>(stop.tsc - start.tsc) * 1e9 / static_cast<double>(stop.nanos - start.nanos));
+}
+
+}
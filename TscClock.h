@@ -0,0 +1,79 @@
+#pragma once
+#ifndef SYS_TSC_CLOCK_H
+#define SYS_TSC_CLOCK_H
+
+#include <cstdint>
+
+#include "Processor.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace sys {
+
+// Time stamp counter as a clock. Reading it is one instruction and converting to nanoseconds one
+// multiply and shift, against a vDSO clock_gettime call per timestamp.
+//
+// Only meaningful across CPUs and sleeps when isInvariant(); without it the rate follows the core
+// clock and every CPU may count from a different point.
+class TscClock {
+public:
+    enum class Source : std::uint32_t {
+        Cpuid,          // leaf 0x15 or the hypervisor timing leaf
+        Calibrated,     // measured against CLOCK_MONOTONIC_RAW
+    };
+
+    explicit        TscClock(const Processor &cpu) noexcept;
+
+    // Raw counter. The CPU may read it before earlier instructions have completed.
+    static INLINE std::uint64_t ticks() noexcept { return __rdtsc(); }
+    // Waits for earlier instructions before reading, for the end of a timed region: rdtscp, or
+    // lfence + rdtsc without Feature::RDTSCP.
+    static INLINE std::uint64_t ticksOrdered() noexcept {
+        if (rdtscp) {
+            unsigned int aux;
+            return __rdtscp(&aux);
+        }
+        _mm_lfence();
+        return __rdtsc();
+    }
+
+    INLINE std::uint64_t toNanos(std::uint64_t ticks) const noexcept;
+    INLINE std::uint64_t nanos() const noexcept { return toNanos(ticks()); }
+
+    std::uint64_t   getFrequency() const noexcept { return frequency; }
+    Source          getSource() const noexcept { return source; }
+    bool            isInvariant() const noexcept { return invariant; }
+
+    // TSC rate in Hz measured over `milliseconds` of CLOCK_MONOTONIC_RAW.
+    static std::uint64_t calibrate(std::uint32_t milliseconds = 50) noexcept;
+
+private:
+    // ns = ticks * mult >> shift, shift fixed so mult keeps 32 fractional bits.
+    static constexpr std::uint32_t shift = 32;
+
+    // Feature::RDTSCP of the running CPU; false (the lfence path) until static initialization.
+    static const bool rdtscp;
+
+    std::uint64_t   frequency;
+    std::uint64_t   mult;
+    Source          source;
+    bool            invariant;
+};
+
+INLINE std::uint64_t TscClock::toNanos(std::uint64_t ticks) const noexcept {
+#ifdef _MSC_VER
+    std::uint64_t high;
+    const std::uint64_t low = _umul128(ticks, mult, &high);
+    return __shiftright128(low, high, shift);
+#else
+    return static_cast<std::uint64_t>((static_cast<unsigned __int128>(ticks) * mult) >> shift);
+#endif
+}
+
+}
+
+#endif // SYS_TSC_CLOCK_H
@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <vector>
 #include <bit>
@@ -335,16 +336,138 @@ struct CPUInfo {
 
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <vector>
+
+#if !defined(_MSC_VER)
+#include <unistd.h>
+#endif
+
+#include "AffinityPlanner.h"
+#include "Cgroup.h"
+#include "CpuidDump.h"
 #include "Processor.h"
+#include "SharedTopology.h"
+#include "TopologyMonitor.h"
+#include "TscClock.h"
 
 namespace sys {
 
-inline static const Processor cpu;
+// SYS_TOPOLOGY_CACHE=<file> reuses the topology of an earlier run instead of probing again.
+inline static const Processor cpu { ProbeBackend::Auto, std::getenv("SYS_TOPOLOGY_CACHE") };
 
 }
 
+static volatile std::sig_atomic_t stopping = 0;
+
+// Daemon mode: publish the topology, then republish whenever the monitor sees CPUs or our cpuset change.
+static int publish(const char *segment, int interval) {
+    sys::TopologyMonitor monitor { sys::ProbeBackend::Auto, std::chrono::seconds(interval) };
+    sys::TopologyPublisher publisher;
+    if (!publisher.open(segment) || !publisher.publish(monitor.current()->processor)) {
+        std::fprintf(stderr, "cannot publish to shared memory segment %s\n", segment);
+        return 1;
+    }
+
+    monitor.subscribe([&](const sys::TopologyMonitor::Snapshot &snapshot, const sys::TopologyChange &change) {
+        publisher.publish(snapshot->processor);
+        std::printf("version %llu: %u cpus added, %u removed\n", static_cast<unsigned long long>(change.version), change.added.count(), change.removed.count());
+    });
 
-int main() {
+    std::signal(SIGINT, [](int) { stopping = 1; });
+    std::signal(SIGTERM, [](int) { stopping = 1; });
+
+    if (!monitor.start()) {
+        std::fprintf(stderr, "cannot start the topology monitor\n");
+        return 1;
+    }
+    std::printf("watching for topology changes (%s)\n", monitor.hasNetlink() ? "uevents and polling" : "polling");
+
+    while (!stopping) {
+#if !defined(_MSC_VER)
+        sleep(1);
+#endif
+    }
+
+    monitor.stop();
+    publisher.unlink();
+    return 0;
+}
+
+// Client side of the daemon: everything below is read straight from the segment.
+static int printShared(const char *segment) {
+    sys::SharedTopology topology;
+    if (!topology.open(segment)) {
+        std::fprintf(stderr, "cannot open shared memory segment %s\n", segment);
+        return 1;
+    }
+
+    topology.read([](const sys::SharedTopology &t) {
+        std::printf("Topology probe: %s (shared)\n", t.getProbeName());
+        std::printf("AVX2: %s\n", t.has(sys::Feature::AVX2) ? "true" : "false");
+        for (const sys::LogicalCore &core: t.getCores()) {
+            std::printf("index: %d, x2apic: 0x%x, chip: %d, core: %d, smt: %d, node: %d, class: %s\n", core.index, core.x2apic,
+                core.chip, core.core, core.smt, core.node, t.getCoreClass(core) == sys::CoreClass::Efficiency ? "E" : "P");
+        }
+    });
+    return 0;
+}
+
+// Every leaf of every CPU plus the sysfs topology, for --replay elsewhere.
+static int dump(const char *path) {
+    sys::CpuidDump dump;
+    if (!dump.capture() || !dump.save(path)) {
+        std::fprintf(stderr, "cannot write cpuid dump %s\n", path);
+        return 1;
+    }
+    std::printf("%u cpus written to %s\n", dump.getCpus().count(), path);
+    return 0;
+}
+
+// The topology and placements of the machine a dump was taken on.
+static int replay(const char *path) {
+    sys::CpuidDump dump;
+    if (!dump.load(path)) {
+        std::fprintf(stderr, "cannot read cpuid dump %s\n", path);
+        return 1;
+    }
+
+    const sys::Processor cpu { dump };
+    std::printf("%s\n%s\n", cpu.getVendorId(), cpu.getBrandId());
+    std::printf("Num logical cores: %u, caches: %zu, nodes: %zu, AVX-512: %s\n", cpu.getNumCores(), cpu.getCaches().size(),
+        cpu.getNumaNodes().size(), cpu.getFeatures().test(sys::Feature::AVX512F) && cpu.isAVX512Enabled() ? "true" : "false");
+
+    for (const sys::LogicalCore &core: cpu.getCores()) {
+        std::printf("index: %d, x2apic: 0x%x, chip: %d, die: %d, ccx: %d, core: %d, smt: %d, node: %d, class: %s\n", core.index, core.x2apic,
+            core.chip, core.die, static_cast<int>(core.ccx), core.core, core.smt, core.node, cpu.getCoreClass(core) == sys::CoreClass::Efficiency ? "E" : "P");
+    }
+
+    std::printf("L3 groups: %zu, dies: %zu\n", cpu.getCpuGroups(sys::Proximity::L3).size(), cpu.getCpuGroups(sys::Proximity::Die).size());
+    for (const sys::Placement placement: { sys::Placement::Compact, sys::Placement::Scatter, sys::Placement::OnePerCore }) {
+        std::printf("%s:", sys::getPlacementName(placement));
+        for (const sys::CpuSet &cpus: sys::planAffinity(cpu, cpu.getNumCores(), placement)) {
+            std::printf(" %u", cpus.first());
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2 && !std::strcmp(argv[1], "--dump")) {
+        return dump(argv[2]);
+    }
+    if (argc > 2 && !std::strcmp(argv[1], "--replay")) {
+        return replay(argv[2]);
+    }
+    if (argc > 1 && !std::strcmp(argv[1], "--publish")) {
+        return publish(argc > 2 ? argv[2] : sys::defaultTopologySegment, argc > 3 ? std::max(1, std::atoi(argv[3])) : 60);
+    }
+    if (argc > 1 && !std::strcmp(argv[1], "--shared")) {
+        return printShared(argc > 2 ? argv[2] : sys::defaultTopologySegment);
+    }
 
     puts(sys::cpu.getVendorId());
     puts(sys::cpu.getBrandId());
@@ -352,6 +475,10 @@ int main() {
     printf("Family ID: %d\n", sys::cpu.getFamilyId());
     printf("Model: %d\n", sys::cpu.getModel());
     std::printf("Num logical cores: %d\n", sys::cpu.getNumCores());
+    const sys::CpuBudget budget = sys::getCpuBudget();
+    std::printf("CPU budget: %.2f of %u cpus (cgroup v%u, quota %.2f), parallelism %u\n", budget.budget, budget.cpus.count(),
+        budget.cgroupVersion, budget.quota, budget.parallelism);
+    std::printf("Topology probe: %s%s\n", sys::cpu.getProbeName(), sys::cpu.isCached() ? " (cached)" : "");
 
     printf("INTEL: %s\n", sys::cpu.isIntel() ? "true" : "false");
     printf("AMD: %s\n", sys::cpu.isAMD() ? "true" : "false");
@@ -363,14 +490,68 @@ int main() {
     printf("AVX: %s\n", sys::cpu.hasAVX() ? "true" : "false");
     printf("HYBRID: %s\n", sys::cpu.hasHYBRID() ? "true" : "false");
 
+    const sys::TscClock tsc { sys::cpu };
+    std::printf("TSC: %.3f MHz (%s), invariant: %s\n", static_cast<double>(tsc.getFrequency()) / 1e6,
+        tsc.getSource() == sys::TscClock::Source::Cpuid ? "cpuid" : "calibrated", tsc.isInvariant() ? "true" : "false");
+
+    std::printf("Features:");
+#define PRINT_FEATURE(name, word, bit) if (sys::cpu.has(sys::Feature::name)) std::printf(" %s", #name);
+    SYS_FEATURE_LIST(PRINT_FEATURE)
+#undef PRINT_FEATURE
+    std::printf("\n");
+
     auto cores = sys::cpu.getCores();
     for (const sys::LogicalCore &core: cores) {
         std::printf("index: %d\n", core.index);
     }
 
     sys::cpu.forEachThread([](const sys::LogicalCore &core) {
-        std::printf("chip: %d, core: %d, core type: %d\n", core.chip, core.core, core.coreType);
+        std::printf("x2apic: 0x%x, chip: %d, die: %d, tile: %d, module: %d, core: %d, smt: %d, node: %d, core type: %d, ccx: %d, ccd: %d\n",
+            core.x2apic, core.chip, core.die, core.tile, core.module, core.core, core.smt, core.node, core.coreType,
+            static_cast<int>(core.ccx), static_cast<int>(core.ccd));
     });
 
+    std::printf("P-cores:");
+    for (const std::uint32_t cpu: sys::cpu.getCoreClassCpus(sys::CoreClass::Performance)) {
+        std::printf(" %d", cpu);
+    }
+    std::printf("\nE-cores:");
+    for (const std::uint32_t cpu: sys::cpu.getCoreClassCpus(sys::CoreClass::Efficiency)) {
+        std::printf(" %d", cpu);
+    }
+    std::printf("\n");
+
+    std::printf("Cache line size: %d\n", sys::cpu.getCacheLineSize());
+
+    for (const sys::Cache &cache: sys::cpu.getCaches()) {
+        static const char *types[] = { "null", "data", "instruction", "unified" };
+        std::printf("L%d %s: %d KiB, %d-way, %d B lines, cpus:", cache.level, types[static_cast<int>(cache.type)],
+            cache.size / 1024, cache.ways, cache.lineSize);
+        for (const std::uint32_t cpu: cache.cpus) {
+            std::printf(" %d", cpu);
+        }
+        std::printf("\n");
+    }
+
+    // Core complexes on AMD, L3 domains elsewhere.
+    std::printf("L3 groups:");
+    for (const sys::CpuSet &group: sys::cpu.getCpuGroups(sys::Proximity::L3)) {
+        std::printf(" [");
+        for (const std::uint32_t cpu: group) {
+            std::printf(cpu == group.first() ? "%d" : " %d", cpu);
+        }
+        std::printf("]");
+    }
+    std::printf("\n");
+
+    for (const sys::NumaNode &node: sys::cpu.getNumaNodes()) {
+        std::printf("node %d: %llu MiB total, %llu MiB free, distances:", node.id,
+            static_cast<unsigned long long>(node.memTotal >> 20), static_cast<unsigned long long>(node.memFree >> 20));
+        for (const std::uint32_t distance: node.distances) {
+            std::printf(" %d", distance);
+        }
+        std::printf("\n");
+    }
+
     return 0;
 }